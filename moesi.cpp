@@ -1,27 +1,78 @@
 #include <iostream>
 #include <array>
-#include <random>
 #include <string>
 #include <thread>
+#include <atomic>
 #include <mutex>
+#include <fstream>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <cassert>
 #include "moesi_types.h"
+#include "moesi_stats.h"
+#include "moesi_profiler.h"
+#include "moesi_workload.h"
+#include "moesi_prefetch.h"
+#include "moesi_protocol.h"
 
 using namespace std;
 
 #define MEMORY_SIZE 2048
 #define CACHE_SIZE 64
-#define NUM_PROCESSORS 4
+#ifndef NUM_PROCESSORS
+#define NUM_PROCESSORS 4            // Override with -DNUM_PROCESSORS=N (4..MAX_CORES)
+#endif
+
+// Simple latency model, in cycles
+#define HIT_LATENCY 1               // Every cache access
+#define BUS_LATENCY 10              // Arbitration and snoop for any bus transaction
+#define CACHE_TO_CACHE_LATENCY 20   // Data supplied by a peer cache
+#define MEMORY_LATENCY 100          // Data read from or written to memory
+#define FAR_ATOMIC_LATENCY 20       // ALU operation at the home node (memory-side atomic unit)
+#define VICTIM_BUFFER_LATENCY 2     // L1 miss served by the victim buffer
+#define L2_LATENCY 8                // L1 miss served by the private L2
+#define LLC_LATENCY 40              // Data read from or written to the shared last-level cache
+
+// Bus traffic, in bytes, for the write-update report
+#define BUS_COMMAND_BYTES 8         // Address and command phase of any bus transaction
+#define BUS_DATA_BYTES ((int)sizeof(word_t))   // One word of data
+
+#ifndef BULK_SNOOP_BATCH
+#define BULK_SNOOP_BATCH 8          // Bus transactions of a bulk operation that share one arbitration and snoop
+#endif
+
+static_assert(NUM_PROCESSORS <= MAX_CORES, "core bitmasks and histograms hold at most MAX_CORES cores");
+static_assert(NUM_PROCESSORS >= 4, "the built-in tests use CPU-0 to CPU-3");
 
 // Global memory shared by all processors
-array<int, MEMORY_SIZE> memory = {0};
+array<word_t, MEMORY_SIZE> memory = {0};
+
+// Number of stores performed to each word, used to tell true sharing from a silent invalidation
+array<unsigned long long, MEMORY_SIZE> word_stores = {0};
 
 // Global mutex to serialize all CPU operations
 mutex operation_mutex;
 
+// Protocol trace output. Long trace replays turn it off, since formatting a
+// dozen lines per access costs far more than the coherence work itself.
+// Building with -DMOESI_NO_LOG removes it entirely (used for benchmarking); the
+// dead branch still names the operands, so variables kept only for logging stay used.
+bool log_enabled = true;
+#ifdef MOESI_NO_LOG
+#define LOG(msg) do { if (false) { cout << msg; } } while (0)
+#else
+#define LOG(msg) do { if (log_enabled) { cout << msg; } } while (0)
+#endif
+
 class CacheLine {
 public:
     int address;
-    int value;
+    word_t value;
     State state;
 
     CacheLine () {
@@ -31,6 +82,406 @@ public:
     }
 };
 
+// Classifies the misses of one core. Tracks which addresses the core has ever
+// touched (compulsory), a fully-associative LRU shadow cache with as many lines
+// as the real one (capacity vs conflict), and for each line lost to a remote
+// invalidation the store count of its word at that moment (true sharing vs silent invalidation).
+// The LRU list is intrusive over address-indexed arrays so the whole object
+// copies safely along with its Processor.
+class MissClassifier {
+private:
+    array<bool, MEMORY_SIZE> touched;
+    array<bool, MEMORY_SIZE> invalidated;                 // Lost to a remote invalidation, not refetched since
+    array<unsigned long long, MEMORY_SIZE> stores_at_invalidation;
+    array<bool, MEMORY_SIZE> in_shadow;
+    array<int, MEMORY_SIZE> lru_prev;
+    array<int, MEMORY_SIZE> lru_next;
+    int lru_head;    // Most recently used
+    int lru_tail;    // Least recently used
+    int shadow_lines;
+
+    void unlink(int address) {
+        if (lru_prev[address] != -1) lru_next[lru_prev[address]] = lru_next[address];
+        else lru_head = lru_next[address];
+        if (lru_next[address] != -1) lru_prev[lru_next[address]] = lru_prev[address];
+        else lru_tail = lru_prev[address];
+    }
+
+    void pushFront(int address) {
+        lru_prev[address] = -1;
+        lru_next[address] = lru_head;
+        if (lru_head != -1) lru_prev[lru_head] = address;
+        lru_head = address;
+        if (lru_tail == -1) lru_tail = address;
+    }
+
+public:
+    MissClassifier() : lru_head(-1), lru_tail(-1), shadow_lines(0) {
+        touched.fill(false);
+        invalidated.fill(false);
+        stores_at_invalidation.fill(0);
+        in_shadow.fill(false);
+    }
+
+    // Classify a miss. Must be called before touch() for the same access.
+    MissClass classify(int address) {
+        if (!touched[address]) {
+            return MissClass::Compulsory;
+        }
+        if (invalidated[address]) {
+            invalidated[address] = false;
+            return word_stores[address] > stores_at_invalidation[address] ? MissClass::TrueSharing : MissClass::SilentInvalidation;
+        }
+        return in_shadow[address] ? MissClass::Conflict : MissClass::Capacity;
+    }
+
+    // Record an access (hit or miss) in the shadow cache
+    void touch(int address) {
+        touched[address] = true;
+        if (in_shadow[address]) {
+            unlink(address);
+        } else if (shadow_lines == CACHE_SIZE) {
+            int victim = lru_tail;
+            unlink(victim);
+            in_shadow[victim] = false;
+        } else {
+            shadow_lines++;
+        }
+        in_shadow[address] = true;
+        pushFront(address);
+    }
+
+    // The core's copy was invalidated by another core's BusRdX/BusUpgr
+    void noteInvalidation(int address) {
+        invalidated[address] = true;
+        stores_at_invalidation[address] = word_stores[address];
+    }
+};
+
+// The atomic ALU, shared by near atomics (in the requester's cache) and far atomics
+// (at memory). Returns the new value of the word. success is false only for a CAS
+// whose comparison failed, in which case the value is returned unchanged.
+word_t atomicALU(const CpuOp& op, const word_t& current, const word_t& operand, const word_t& expected, bool& success) {
+    success = true;
+    switch(op) {
+        case CpuOp::Atomic_CAS: 
+            // Compare-And-Swap: if current value matches expected, replace with new value
+            if (current == expected) return operand;
+            success = false;
+            return current;
+        case CpuOp::Atomic_ADD: return static_cast<word_t>(static_cast<uword_t>(current) + static_cast<uword_t>(operand));
+        case CpuOp::Atomic_SUB: return static_cast<word_t>(static_cast<uword_t>(current) - static_cast<uword_t>(operand));
+        case CpuOp::Atomic_AND: return current & operand;
+        case CpuOp::Atomic_OR: return current | operand;
+        case CpuOp::Atomic_XOR: return current ^ operand;
+        case CpuOp::Atomic_NAND: return ~(current & operand);
+        case CpuOp::Atomic_NOR: return ~(current | operand);
+        case CpuOp::Atomic_XNOR: return ~(current ^ operand);
+        default: return current;
+    }
+}
+
+// Decides per address whether an atomic runs near or far. Addresses can be pinned
+// to either; the rest follow the default policy. Under Adaptive, each address keeps
+// a saturating score: an atomic from a different core than the previous one raises
+// it, a repeat from the same core lowers it, and the address goes far while the
+// score is at or above the threshold. A line held in M or E always stays near,
+// since that needs no bus transaction at all.
+class AtomicPolicyTable {
+private:
+    enum Pin : unsigned char { Unpinned, PinnedNear, PinnedFar };
+
+    array<unsigned char, MEMORY_SIZE> pins;
+    array<int, MEMORY_SIZE> score;
+    array<int, MEMORY_SIZE> last_core;
+
+public:
+    AtomicPolicy policy;
+    int threshold;
+
+    AtomicPolicyTable() : policy(AtomicPolicy::Near), threshold(4) {
+        pins.fill(Unpinned);
+        score.fill(0);
+        last_core.fill(-1);
+    }
+
+    // Drop the adaptive history, keeping the policy and the pins
+    void forgetHistory() {
+        score.fill(0);
+        last_core.fill(-1);
+    }
+
+    void pin(int address, AtomicPolicy where) {
+        pins[address] = (where == AtomicPolicy::Far) ? PinnedFar : PinnedNear;
+    }
+
+    // True when no atomic can run far, so every one is a plain near access
+    bool alwaysNear() const {
+        if (policy != AtomicPolicy::Near) return false;
+        for (unsigned char pin : pins) {
+            if (pin == PinnedFar) return false;
+        }
+        return true;
+    }
+
+    // Record an atomic by core to address and say whether it should run far
+    bool executeFar(int address, int core, bool held_exclusive) {
+        if (last_core[address] != -1) {
+            if (last_core[address] != core) score[address] = min(score[address] + 1, 2 * threshold);
+            else score[address] = max(score[address] - 1, 0);
+        }
+        last_core[address] = core;
+
+        if (held_exclusive || pins[address] == PinnedNear) return false;
+        if (pins[address] == PinnedFar) return true;
+        switch (policy) {
+            case AtomicPolicy::Far: return true;
+            case AtomicPolicy::Adaptive: return score[address] >= threshold;
+            default: return false;
+        }
+    }
+};
+
+AtomicPolicyTable atomic_policy;
+
+// Shared last-level cache between the bus and memory. Set-associative with LRU
+// replacement and write-back to memory. Like the private caches a line holds one
+// word, at set (address/4) % sets. Each line also keeps a bitmask of the cores
+// that may hold it privately, which the inclusive policy uses as a snoop filter.
+class LastLevelCache {
+public:
+    struct Line {
+        int address;                  // -1 when the way is empty
+        word_t value;
+        bool dirty;                   // Newer than memory
+        uint64_t sharers;             // Cores that may hold the line (a superset is safe)
+        unsigned long long last_use;
+    };
+
+    LLCPolicy policy;
+
+private:
+    int sets;
+    int ways;
+    vector<Line> lines;               // sets * ways, set-major
+    unsigned long long clock;
+
+    int slot(int address) const {
+        int base = ((address / 4) % sets) * ways;
+        for (int way = 0; way < ways; way++) {
+            if (lines[base + way].address == address) return base + way;
+        }
+        return -1;
+    }
+
+public:
+    LastLevelCache() : policy(LLCPolicy::None), sets(0), ways(0), clock(0) {}
+
+    void configure(LLCPolicy new_policy, int new_sets, int new_ways) {
+        policy = new_policy;
+        sets = new_sets;
+        ways = new_ways;
+        clear();
+    }
+
+    bool enabled() const { return policy != LLCPolicy::None; }
+
+    void clear() {
+        Line empty = {-1, 0, false, 0, 0};
+        lines.assign(static_cast<size_t>(sets) * ways, empty);
+        clock = 0;
+    }
+
+    Line* find(int address) {
+        int i = enabled() ? slot(address) : -1;
+        return i < 0 ? nullptr : &lines[i];
+    }
+
+    const Line* find(int address) const {
+        int i = enabled() ? slot(address) : -1;
+        return i < 0 ? nullptr : &lines[i];
+    }
+
+    void touch(Line& line) { line.last_use = ++clock; }
+
+    void remove(Line& line) {
+        line.address = -1;
+        line.dirty = false;
+        line.sharers = 0;
+    }
+
+    // Claim a way for a line that is not present: an empty one, else the least
+    // recently used. The displaced line, if any, is copied to victim.
+    Line& allocate(int address, word_t value, bool dirty, Line& victim) {
+        int base = ((address / 4) % sets) * ways;
+        int chosen = base;
+        for (int way = 0; way < ways; way++) {
+            const Line& candidate = lines[base + way];
+            if (candidate.address == -1) {
+                chosen = base + way;
+                break;
+            }
+            if (candidate.last_use < lines[chosen].last_use) chosen = base + way;
+        }
+        victim = lines[chosen];
+        Line& line = lines[chosen];
+        line.address = address;
+        line.value = value;
+        line.dirty = dirty;
+        line.sharers = 0;
+        touch(line);
+        return line;
+    }
+};
+
+// Optional private L2 behind each core's L1, set-associative with LRU replacement.
+// A line's coherence state lives wherever the line is: in the L1 while it is there,
+// else in its L2 entry. Under the inclusive policy an entry marked in_l1 stands for
+// a line held above the L2 (in the L1 or the victim buffer), so a snoop that finds
+// no entry need not probe the L1.
+class PrivateL2 {
+public:
+    struct Entry {
+        CacheLine line;               // Invalid while in_l1: the copy above is the live one
+        bool in_l1;
+        unsigned long long last_use;
+
+        Entry() : in_l1(false), last_use(0) {}
+    };
+
+    L2Policy policy;
+
+private:
+    int sets;
+    int ways;
+    vector<Entry> entries;            // sets * ways, set-major
+    unsigned long long clock;
+
+    int slot(int address) const {
+        int base = ((address / 4) % sets) * ways;
+        for (int way = 0; way < ways; way++) {
+            const Entry& entry = entries[base + way];
+            if (entry.line.address == address && (entry.in_l1 || entry.line.state != State::Invalid)) return base + way;
+        }
+        return -1;
+    }
+
+public:
+    PrivateL2() : policy(L2Policy::None), sets(0), ways(0), clock(0) {}
+
+    void configure(L2Policy new_policy, int new_sets, int new_ways) {
+        policy = new_policy;
+        sets = new_sets;
+        ways = new_ways;
+        entries.assign(static_cast<size_t>(sets) * ways, Entry());
+        clock = 0;
+    }
+
+    bool enabled() const { return policy != L2Policy::None; }
+
+    Entry* find(int address) {
+        int i = enabled() ? slot(address) : -1;
+        return i < 0 ? nullptr : &entries[i];
+    }
+
+    const Entry* find(int address) const {
+        int i = enabled() ? slot(address) : -1;
+        return i < 0 ? nullptr : &entries[i];
+    }
+
+    void touch(Entry& entry) { entry.last_use = ++clock; }
+
+    // The entry a new line for address displaces: an unused one, else the least recently used
+    Entry& victimFor(int address) {
+        int base = ((address / 4) % sets) * ways;
+        int chosen = base;
+        for (int way = 0; way < ways; way++) {
+            const Entry& candidate = entries[base + way];
+            if (!candidate.in_l1 && candidate.line.state == State::Invalid) return entries[base + way];
+            if (candidate.last_use < entries[chosen].last_use) chosen = base + way;
+        }
+        return entries[chosen];
+    }
+
+    const vector<Entry>& all() const { return entries; }
+};
+
+// Small fully-associative buffer of cache lines, used for the victim buffer (L1
+// conflict victims, Jouppi) and the write-back buffer. Lines keep their coherence
+// state while they sit here, so snoops treat them like any other copy. Replacement
+// is LRU over touch(); touching only on insertion gives FIFO.
+class LineBuffer {
+private:
+    vector<CacheLine> lines;
+    vector<unsigned long long> last_use;
+    unsigned long long clock;
+
+public:
+    LineBuffer() : clock(0) {}
+
+    void configure(int entries) {
+        lines.assign(entries, CacheLine());
+        last_use.assign(entries, 0);
+        clock = 0;
+    }
+
+    bool enabled() const { return !lines.empty(); }
+
+    CacheLine* find(int address) {
+        for (CacheLine& line : lines) {
+            if (line.state != State::Invalid && line.address == address) return &line;
+        }
+        return nullptr;
+    }
+
+    const CacheLine* find(int address) const {
+        return const_cast<LineBuffer*>(this)->find(address);
+    }
+
+    void touch(const CacheLine& line) { last_use[&line - &lines[0]] = ++clock; }
+
+    // The line a new entry displaces: a free one, else the least recently used
+    CacheLine& oldest() {
+        size_t chosen = 0;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i].state == State::Invalid) return lines[i];
+            if (last_use[i] < last_use[chosen]) chosen = i;
+        }
+        return lines[chosen];
+    }
+
+    // The least recently used line that holds data, or nullptr when the buffer is empty
+    CacheLine* oldestValid() {
+        CacheLine* chosen = nullptr;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i].state == State::Invalid) continue;
+            if (!chosen || last_use[i] < last_use[chosen - &lines[0]]) chosen = &lines[i];
+        }
+        return chosen;
+    }
+
+    const vector<CacheLine>& all() const { return lines; }
+};
+
+// Private hierarchy built into every Processor; set from the command line
+struct L2Config {
+    L2Policy policy;
+    int sets;
+    int ways;
+};
+L2Config l2_config = {L2Policy::None, 64, 4};
+int victim_buffer_entries = 0;   // 0: no victim buffer
+int writeback_buffer_entries = 0;   // 0: dirty victims are written back before the miss proceeds
+struct PrefetchConfig {
+    PrefetcherKind kind;
+    int degree;
+};
+PrefetchConfig prefetch_config = {PrefetcherKind::None, 2};
+bool ownership_prediction = false;   // Learn read-then-store addresses and read them with BusRdX
+bool bulk_non_temporal = false;      // Bulk operations write their destination with Store_NT
+array<bool, MEMORY_SIZE> write_update = {};   // Stores to shared copies of these addresses send BusUpd instead of invalidating
+bool write_update_enabled = false;            // Some address uses write-update
+
 // Logical Processor Cache.
 
 class Processor {
@@ -38,6 +489,17 @@ class Processor {
 private:
     int id;
     Bus* bus;  // Reference to the shared bus
+    int reserved_address;                     // Address reserved by the last Load_Linked, or -1
+    unsigned long long sc_failed_streak;      // Failed Store_Conditionals since the last success
+    int prefetch_trigger;                     // Demand miss address the prefetcher trains on after this operation, or -1
+    array<bool, MEMORY_SIZE> prefetch_pending;           // Prefetched, no demand access since
+    array<unsigned long long, MEMORY_SIZE> prefetch_ready;   // Cycle a pending prefetch's data arrives
+    array<bool, MEMORY_SIZE> prefetch_displaced;         // Evicted from the L1 by a prefetch, no demand access since
+    array<unsigned char, MEMORY_SIZE> store_watch;       // Read miss awaiting a store: 1 plain BusRd, 2 predicted BusRdX
+    array<bool, MEMORY_SIZE> upgrade_avoidable;          // Read with BusRdX while other copies existed, no store since
+    array<bool, MEMORY_SIZE> update_fresh;               // Refreshed by a remote BusUpd, no access since
+    bool bulk_batching;                       // A bulk operation is running: its bus transactions are batched
+    int snoop_batch_left;                     // Transactions that still fit in the current batch
     
     // Helper function to calculate cache index (direct-mapped)
     // Ignores lower 2 bits (byte offset within DW) and uses modulo CACHE_SIZE
@@ -47,158 +509,802 @@ private:
     
 public:
     array<CacheLine, CACHE_SIZE> cache;  // Local L1 Cache for Logical Processor.
+    LineBuffer victims;                  // Optional victim buffer between L1 and L2 (victim_buffer_entries)
+    PrivateL2 l2;                        // Optional private L2 (l2_config)
+    LineBuffer writebacks;               // Optional write-back buffer, drained in FIFO order (writeback_buffer_entries)
+    Prefetcher prefetcher;               // Optional hardware prefetcher (prefetch_config)
+    OwnershipPredictor ownership;        // Optional read-for-ownership predictor (ownership_prediction)
+    CoreStats stats;                     // Event counters for this core
+    MissClassifier classifier;           // Sorts this core's misses into MissClass buckets
+    HostCounters host;                   // Operation lock contention seen by the driving thread
 
-    Processor(int id = 0, Bus* b = nullptr) : id(id), bus(b) {
+    // Move a line to a new state, counting the transition
+    void setState(CacheLine& line, State next) {
+        if (line.state != next) {
+            stats.transitions[static_cast<int>(line.state)][static_cast<int>(next)]++;
+        }
+        line.state = next;
+    }
+
+    // Invalidate a line in response to another core's BusRdX/BusUpgr
+    void snoopInvalidate(CacheLine& line) {
+        setState(line, State::Invalid);
+        classifier.noteInvalidation(line.address);
+        notePrefetchLost(line.address);
+        if (line.address == reserved_address) {
+            reserved_address = -1;
+            stats.reservations_invalidated++;
+            LOG("CPU - " << id << ": Reservation cleared @ addr 0x" << hex << line.address << dec << " | remote invalidation" << endl);
+        }
+    }
+
+    // Another core's BusUpd wrote value to this copy. The copy stays valid, but the
+    // remote store still breaks a reservation on it.
+    void takeUpdate(CacheLine& line, word_t value) {
+        line.value = value;
+        stats.updates_received++;
+        if (update_fresh[line.address]) stats.updates_unread++;
+        update_fresh[line.address] = true;
+        if (line.address == reserved_address) {
+            reserved_address = -1;
+            stats.reservations_invalidated++;
+            LOG("CPU - " << id << ": Reservation cleared @ addr 0x" << hex << line.address << dec << " | remote update" << endl);
+        }
+    }
+
+    // The inclusive LLC evicted address: drop this core's copy. Returns true, with the
+    // data in data, when the copy was dirty and so must go to memory with the victim.
+    bool backInvalidate(int address, word_t& data) {
+        CacheLine* copy = findLine(address);
+        if (!copy) return false;
+        CacheLine& line = *copy;
+        bool dirty = (line.state == State::Modified || line.state == State::Owned);
+        if (dirty) data = line.value;
+        stats.back_invalidations++;
+        LOG("CPU - " << id << ": Back-invalidation from LLC @ addr 0x" << hex << address << dec << " | ["
+             << stateToString(line.state) << "->" << stateToString(State::Invalid) << "]" << endl);
+        if (address == reserved_address) {
+            reserved_address = -1;
+            stats.reservations_evicted++;
+        }
+        setState(line, State::Invalid);
+        notePrefetchLost(address);
+        return dirty;
+    }
+
+    Processor(int id = 0, Bus* b = nullptr) : id(id), bus(b), reserved_address(-1), sc_failed_streak(0), prefetch_trigger(-1),
+                                                 bulk_batching(false), snoop_batch_left(0) {
+        victims.configure(victim_buffer_entries);
+        l2.configure(l2_config.policy, l2_config.sets, l2_config.ways);
+        writebacks.configure(writeback_buffer_entries);
+        prefetcher.kind = prefetch_config.kind;
+        prefetcher.degree = prefetch_config.degree;
+        prefetch_pending.fill(false);
+        prefetch_ready.fill(0);
+        prefetch_displaced.fill(false);
+        ownership.enabled = ownership_prediction;
+        store_watch.fill(0);
+        upgrade_avoidable.fill(false);
+        update_fresh.fill(false);
+    }
+
+    // This core's valid copy of address above the L2 (L1 or victim buffer), or nullptr
+    const CacheLine* findAbove(int address) const {
+        const CacheLine& l1 = cache[getCacheIndex(address)];
+        if (l1.state != State::Invalid && l1.address == address) return &l1;
+        return victims.find(address);
+    }
+
+    CacheLine* findAbove(int address) {
+        return const_cast<CacheLine*>(static_cast<const Processor*>(this)->findAbove(address));
+    }
+
+    // This core's valid copy of address at any level, or nullptr
+    const CacheLine* findLine(int address) const {
+        const CacheLine* above = findAbove(address);
+        if (above) return above;
+        const PrivateL2::Entry* entry = l2.find(address);
+        if (entry && !entry->in_l1 && entry->line.state != State::Invalid) return &entry->line;
+        return writebacks.find(address);
+    }
+
+    CacheLine* findLine(int address) {
+        return const_cast<CacheLine*>(static_cast<const Processor*>(this)->findLine(address));
+    }
+
+    // The line a snoop for address examines. The victim and write-back buffers are
+    // always searched. Without an entry in an inclusive L2 the L1 cannot hold the
+    // line, so the snoop is filtered and gets nullptr instead of probing it.
+    CacheLine* snoopLine(int address) {
+        CacheLine* l1 = &cache[getCacheIndex(address)];
+        CacheLine* buffered = victims.find(address);
+        if (!buffered) buffered = writebacks.find(address);
+        if (buffered) return buffered;
+        if (!l2.enabled()) return l1;
+        PrivateL2::Entry* entry = l2.find(address);
+        if (entry && !entry->in_l1) return &entry->line;
+        if (!entry && l2.policy == L2Policy::Inclusive) {
+            stats.l1_snoops_filtered++;
+            return nullptr;
+        }
+        return l1;
+    }
+
+    // Call visit(line) for every valid line this core holds, at any level
+    template <typename Visit>
+    void forEachLine(Visit visit) const {
+        for (const CacheLine& line : cache) {
+            if (line.state != State::Invalid) visit(line);
+        }
+        for (const CacheLine& line : victims.all()) {
+            if (line.state != State::Invalid) visit(line);
+        }
+        for (const PrivateL2::Entry& entry : l2.all()) {
+            if (!entry.in_l1 && entry.line.state != State::Invalid) visit(entry.line);
+        }
+        for (const CacheLine& line : writebacks.all()) {
+            if (line.state != State::Invalid) visit(line);
+        }
+    }
+
+    void countAccess(const CpuOp& op, const int& address, bool is_hit) {
+        if (prefetcher.enabled()) {
+            countPrefetchUse(address, is_hit);
+        }
+        if (write_update_enabled && update_fresh[address]) {
+            // Under invalidation this access would have missed and fetched the line with a BusRd
+            update_fresh[address] = false;
+            if (is_hit) {
+                stats.update_hits++;
+                stats.invalidate_bytes += BUS_COMMAND_BYTES + BUS_DATA_BYTES;
+            }
+        }
+        if (is_hit) {
+            stats.hits[static_cast<int>(op)]++;
+        } else {
+            stats.misses[static_cast<int>(op)]++;
+            stats.miss_classes[static_cast<int>(classifier.classify(address))]++;
+        }
+        classifier.touch(address);
+    }
+
+    void countFill(const BusResponse& response) {
+        if (response.data_from_memory) {
+            if (!response.data_from_llc) stats.memory_fills++;
+        } else {
+            stats.cache_to_cache++;
+        }
+    }
+
+    // Score the prefetcher against one demand access. A pending prefetch still held
+    // anywhere in the core was useful; if its fill is still in flight the access
+    // waits for the remainder. A miss on a line a prefetch displaced is pollution.
+    void countPrefetchUse(int address, bool is_hit) {
+        if (prefetch_pending[address]) {
+            prefetch_pending[address] = false;
+            if (findLine(address)) {
+                stats.prefetch_useful++;
+                if (stats.cycles < prefetch_ready[address]) {
+                    stats.prefetch_late++;
+                    stats.prefetch_late_cycles += prefetch_ready[address] - stats.cycles;
+                    stats.cycles = prefetch_ready[address];
+                }
+            }
+        }
+        if (prefetch_displaced[address]) {
+            prefetch_displaced[address] = false;
+            if (!is_hit) stats.prefetch_pollution++;
+        }
+    }
+
+    // A prefetched line was invalidated before any demand access reached it
+    void notePrefetchLost(int address) {
+        if (address >= 0 && address < MEMORY_SIZE && prefetch_pending[address]) {
+            prefetch_pending[address] = false;
+            stats.prefetch_invalidated++;
+        }
+    }
+
+    // Train the prefetcher on this operation's demand miss and issue what it proposes.
+    // Candidates already held by the core, or mapping to the demand line's L1 slot or
+    // the reserved line's, are dropped.
+    void issuePrefetches(int demand_index) {
+        if (prefetch_trigger < 0) return;
+        vector<int> candidates;
+        prefetcher.onMiss(prefetch_trigger, candidates);
+        prefetch_trigger = -1;
+        for (int address : candidates) {
+            if (address < 0 || address >= MEMORY_SIZE || findLine(address)) continue;
+            int index = getCacheIndex(address);
+            if (index == demand_index) continue;
+            if (cache[index].state != State::Invalid && cache[index].address == reserved_address) continue;
+            prefetchLine(address, index);
+        }
+    }
+
+    // Fetch address into the L1 with a BusRd whose latency is not charged to the
+    // demand access; the data is ready once that latency has passed
+    void prefetchLine(int address, int index) {
+        if (cache[index].state != State::Invalid) {
+            prefetch_displaced[cache[index].address] = true;
+        }
+        handleCacheEviction(address, index);
+        LOG("CPU - " << id << ": Prefetch | BusRd @ addr 0x" << hex << address << dec << endl);
+        BusResponse response = send_bus_operation(BusOp::BusRd, address, id, false);
+        cache[index].address = address;
+        cache[index].value = response.data;
+        setState(cache[index], response.requester_new_state);
+        noteL1Fill(address);
+        prefetch_pending[address] = true;
+        prefetch_ready[address] = stats.cycles + busLatency(BusOp::BusRd, response);
+        stats.prefetches_issued++;
+    }
+
+    // Decide whether a read miss should fetch its line for ownership. A read miss to an
+    // address still watched for a store means the last read was not followed by one.
+    bool readForOwnership(const CpuOp& op, int address) {
+        if (op == CpuOp::PrefetchW) return true;
+        if (!ownership.enabled) return false;
+        if (store_watch[address] != 0) {
+            if (store_watch[address] == 2) stats.rfo_mispredicted++;
+            ownership.train(address, false);
+        }
+        bool predicted = ownership.predict(address);
+        store_watch[address] = predicted ? 2 : 1;
+        if (predicted) stats.rfo_predicted++;
+        return predicted;
+    }
+
+    // A store (Write, near atomic, Store_Conditional) reached address; line is the
+    // L1 copy if it hit. Trains the predictor and credits a read for ownership whose
+    // line is still exclusive, as the store would otherwise have needed a BusUpgr.
+    void noteStore(int address, const CacheLine& line, bool is_hit) {
+        if (store_watch[address] != 0) {
+            ownership.train(address, true);
+            store_watch[address] = 0;
+        }
+        if (upgrade_avoidable[address]) {
+            upgrade_avoidable[address] = false;
+            if (is_hit && (line.state == State::Modified || line.state == State::Exclusive)) {
+                stats.upgrades_avoided++;
+            }
+        }
+    }
+
+    // Write-update store to an L1 line other caches may share; the line already holds
+    // the new value. BusUpd carries it to the other copies and the response gives the
+    // writer's state: the line stays shared, or is Modified if no other copy answered.
+    void updateSharers(CacheLine& line) {
+        State present_state = line.state;
+        stats.update_bytes += BUS_COMMAND_BYTES + BUS_DATA_BYTES;
+        stats.invalidate_bytes += BUS_COMMAND_BYTES;   // The BusUpgr invalidation would have sent
+
+        LOG("CPU - " << id << ": Sending Bus Request | BusUpd @ addr 0x" << hex << line.address << dec << endl);
+        BusResponse response = send_bus_operation(BusOp::BusUpd, line.address, id);
+        LOG("CPU - " << id << ": Requester Bus Response Received | BusUpd completed" << endl);
+        LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state)
+             << "->" << stateToString(response.requester_new_state) << "]" << endl);
+        setState(line, response.requester_new_state);
     }
 
     void printCacheLine(const int& address) {
         int index = getCacheIndex(address);
-        cout << "CPU - " << id << ": Cache line " << index << ": address=" << cache[index].address << " value=" << cache[index].value << " state=" << stateToString(cache[index].state) << endl;
+        LOG("CPU - " << id << ": Cache line " << index << ": address=" << cache[index].address << " value=" << cache[index].value << " state=" << stateToString(cache[index].state) << endl);
     }
 
     // Handle cache eviction with write-back for dirty data
     void handleCacheEviction(const int& new_address, const int& cache_index) {
         bool conflict_miss = (cache[cache_index].state != State::Invalid) && (cache[cache_index].address != new_address);
+        if (conflict_miss && cache[cache_index].address == reserved_address) {
+            reserved_address = -1;
+            stats.reservations_evicted++;
+            LOG("CPU - " << id << ": Reservation cleared @ addr 0x" << hex << cache[cache_index].address << dec << " | evicted" << endl);
+        }
+
+        // With a victim buffer or L2 the victim moves down with its state; nothing leaves the core yet
+        if (conflict_miss && victims.enabled()) {
+            LOG("CPU - " << id << ": L1 victim @ addr 0x" << hex << cache[cache_index].address << dec
+                 << " moved to victim buffer | state: " << stateToString(cache[cache_index].state) << endl);
+            moveToVictimBuffer(cache[cache_index]);
+            return;
+        }
+        if (conflict_miss && l2.enabled()) {
+            LOG("CPU - " << id << ": L1 victim @ addr 0x" << hex << cache[cache_index].address << dec
+                 << " moved to L2 | state: " << stateToString(cache[cache_index].state) << endl);
+            moveToL2(cache[cache_index]);
+            return;
+        }
         
-        if (conflict_miss && (cache[cache_index].state == State::Modified || cache[cache_index].state == State::Owned)) {
+        if (conflict_miss && writebacks.enabled() && (cache[cache_index].state == State::Modified || cache[cache_index].state == State::Owned)) {
+            queueWriteBack(cache[cache_index]);
+        } else if (conflict_miss && (cache[cache_index].state == State::Modified || cache[cache_index].state == State::Owned)) {
             // Write back dirty data to memory before evicting
             int old_address = cache[cache_index].address;
-            int old_value = cache[cache_index].value;
+            word_t old_value = cache[cache_index].value;
             
-            cout << "CPU - " << id << ": Conflict miss detected with dirty data | write-back required" << endl;
-            cout << "CPU - " << id << ": Sending Bus Request | BusWB @ addr 0x" << hex << old_address << dec << endl;
+            LOG("CPU - " << id << ": Conflict miss detected with dirty data | write-back required" << endl);
+            LOG("CPU - " << id << ": Sending Bus Request | BusWB @ addr 0x" << hex << old_address << dec << endl);
             send_bus_operation(BusOp::BusWB, old_address, id);
-            cout << "CPU - " << id << ": Write-back completed | data: 0x" << hex << old_value << dec << " written to memory" << endl;
+            LOG("CPU - " << id << ": Write-back completed | data: 0x" << hex << old_value << dec << " written to memory" << endl);
             
             // Invalidate the evicted line
-            cache[cache_index].state = State::Invalid;
+            setState(cache[cache_index], State::Invalid);
+        } else if (conflict_miss) {
+            // Clean victim: memory is already up to date, just drop it
+            int old_address = cache[cache_index].address;
+            setState(cache[cache_index], State::Invalid);
+            cleanLineDropped(old_address);
         }
     }
 
-    // Perform atomic operation on cache value
-    void performAtomicOperation(const CpuOp& op, const int& value, const int& cache_index, const int& expected_value = 0) {
-        int old_value = cache[cache_index].value;
-        switch(op) {
-            case CpuOp::Atomic_CAS: 
-                // Compare-And-Swap: if current value matches expected, replace with new value
-                if (cache[cache_index].value == expected_value) {
-                    cache[cache_index].value = value;
-                } // else do nothing - CAS failed
-                break;
-            case CpuOp::Atomic_ADD: 
-                cache[cache_index].value += value; 
-                break;
-            case CpuOp::Atomic_SUB: 
-                cache[cache_index].value -= value; 
-                break;
-            case CpuOp::Atomic_AND: 
-                cache[cache_index].value &= value; 
-                break;
-            case CpuOp::Atomic_OR:  
-                cache[cache_index].value |= value; 
-                break;
-            case CpuOp::Atomic_XOR: 
-                cache[cache_index].value ^= value; 
-                break;
-            case CpuOp::Atomic_NAND: 
-                cache[cache_index].value = ~(cache[cache_index].value & value); 
-                break;
-            case CpuOp::Atomic_NOR:  
-                cache[cache_index].value = ~(cache[cache_index].value | value); 
-                break;
-            case CpuOp::Atomic_XNOR: 
-                cache[cache_index].value = ~(cache[cache_index].value ^ value); 
-                break;
-            default: 
-                break;
+    // Tell the LLC a clean line left this cache without a bus transaction
+    void cleanLineDropped(int address);
+
+    // A line leaves the core from a lower level: written back over the bus if dirty,
+    // dropped if clean
+    void leaveCore(CacheLine& line, const string& level) {
+        if (writebacks.enabled() && (line.state == State::Modified || line.state == State::Owned)) {
+            queueWriteBack(line);
+        } else if (line.state == State::Modified || line.state == State::Owned) {
+            LOG("CPU - " << id << ": " << level << " eviction with dirty data | write-back required" << endl);
+            LOG("CPU - " << id << ": Sending Bus Request | BusWB @ addr 0x" << hex << line.address << dec << endl);
+            send_bus_operation(BusOp::BusWB, line.address, id);
+            setState(line, State::Invalid);
+        } else if (line.state != State::Invalid) {
+            setState(line, State::Invalid);
+            cleanLineDropped(line.address);
         }
-        cout << "CPU - " << id << ": Performing atomic operation | type: " << cpuOpToString(op) 
-             << " | old value: 0x" << hex << old_value << dec 
-             << " | operand: 0x" << hex << value << dec 
-             << " | new value: 0x" << hex << cache[cache_index].value << dec << endl;
     }
 
-    void cpu_operation(const CpuOp& op, const int& address, const int& value = 0, const int& expected_value = 0) {
-        // Lock the entire CPU operation to prevent thread interleaving
-        lock_guard<mutex> lock(operation_mutex);
+    // Park a dirty line that is leaving the core in the write-back buffer, so the miss
+    // that evicted it need not wait for its BusWB. A full buffer stalls the miss
+    // while the oldest entry drains.
+    void queueWriteBack(CacheLine& line) {
+        int address = line.address;
+        CacheLine& slot = writebacks.oldest();
+        if (slot.state != State::Invalid) {
+            stats.wb_full_stalls++;
+            drainWriteBack(slot, true);
+        }
+        if (line.state == State::Invalid || line.address != address) return;
+        LOG("CPU - " << id << ": Dirty victim @ addr 0x" << hex << address << dec << " queued in write-back buffer | state: " << stateToString(line.state) << endl);
+        slot = line;
+        line.state = State::Invalid;
+        writebacks.touch(slot);
+        stats.wb_queued++;
+    }
 
-        cout << "========================================" << endl;
-        if (op == CpuOp::Write) {
-            cout << "CPU - " << id << ": Executing Instruction: " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << " | data: 0x" << hex << value << dec << endl;
-        } else {
-            cout << "CPU - " << id << ": Executing Instruction: " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << endl;
+    // Write one buffered line back. Off the critical path its bus time is not
+    // charged to the core.
+    void drainWriteBack(CacheLine& line, bool critical_path) {
+        LOG("CPU - " << id << ": Draining write-back buffer | BusWB @ addr 0x" << hex << line.address << dec << endl);
+        send_bus_operation(BusOp::BusWB, line.address, id, critical_path);
+        setState(line, State::Invalid);
+    }
+
+    // Background drain after each operation: the oldest buffered line, if any
+    void drainOldestWriteBack() {
+        CacheLine* oldest = writebacks.oldestValid();
+        if (oldest) {
+            drainWriteBack(*oldest, false);
         }
-        cout << "========================================" << endl;
-        
-        int index = getCacheIndex(address);
-        
-        switch (op) {
-            case CpuOp::Read: {
+    }
 
-                // Check for cache hit: valid state AND matching address
-                bool is_hit = (cache[index].state != State::Invalid) && (cache[index].address == address);
-                
-                // Print 1: CPU Request (Hit/Miss) with initial state
-                if (!is_hit) {
-                    cout << "CPU - " << id << ": Cache-MISS @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl;
-                } else {
-                    cout << "CPU - " << id << ": Cache-HIT @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl;
+    // Move a line (L1 or victim buffer) into the victim buffer. Room is made first,
+    // while the line is still in place: the displaced entry moves on to the L2, or
+    // leaves the core. Its write-back can cost the line itself through an inclusive
+    // LLC, in which case there is nothing left to move.
+    void moveToVictimBuffer(CacheLine& line) {
+        int address = line.address;
+        CacheLine& slot = victims.oldest();
+        if (slot.state != State::Invalid) {
+            stats.victim_evictions++;
+            if (l2.enabled()) moveToL2(slot);
+            else leaveCore(slot, "Victim buffer");
+        }
+        if (line.state == State::Invalid || line.address != address) return;
+        slot = line;
+        line.state = State::Invalid;
+        victims.touch(slot);
+    }
+
+    // Move a line from above into the L2, in the entry it already has or a new one.
+    // Room is made first, as for the victim buffer.
+    void moveToL2(CacheLine& line) {
+        int address = line.address;
+        PrivateL2::Entry* entry = l2.find(address);
+        if (!entry) entry = &allocateL2(address);
+        if (line.state == State::Invalid || line.address != address) return;
+        entry->line = line;
+        entry->in_l1 = false;
+        line.state = State::Invalid;
+        l2.touch(*entry);
+    }
+
+    // Claim an L2 entry for address. An inclusive L2 first takes its victim back from
+    // the L1 or victim buffer. The victim then leaves the core.
+    PrivateL2::Entry& allocateL2(int address) {
+        PrivateL2::Entry& entry = l2.victimFor(address);
+        if (entry.in_l1) {
+            CacheLine* above = findAbove(entry.line.address);
+            if (above) {
+                LOG("CPU - " << id << ": L2 back-invalidation @ addr 0x" << hex << above->address << dec
+                     << " | state: " << stateToString(above->state) << endl);
+                if (above->address == reserved_address) {
+                    reserved_address = -1;
+                    stats.reservations_evicted++;
                 }
-                
-                if (!is_hit) {
-                    // Handle cache eviction with write-back for dirty data
-                    handleCacheEviction(address, index);
-                    
-                    // Save present state before bus operation
-                    State present_state = cache[index].state;
-                    
-                    // Print Bus Request
-                    cout << "CPU - " << id << ": Sending Bus Request | BusRd @ addr 0x" << hex << address << dec << endl;
+                entry.line = *above;
+                above->state = State::Invalid;
+                stats.l2_back_invalidations++;
+            }
+            entry.in_l1 = false;
+        }
+        leaveCore(entry.line, "L2");
+        entry.line.address = address;
+        l2.touch(entry);
+        return entry;
+    }
 
-                    // Issue BusRd transaction to the bus.
-                    BusResponse response = send_bus_operation(BusOp::BusRd, address, id);
-                    
-                    // Update cache with fetched data
-                    cache[index].address = address;  // Store full address
-                    cache[index].value = response.data;
-                    cache[index].state = response.requester_new_state;
+    // A line just entered the L1. An inclusive L2 keeps an entry standing for it.
+    void noteL1Fill(int address) {
+        if (l2.policy != L2Policy::Inclusive) return;
+        PrivateL2::Entry* entry = l2.find(address);
+        if (!entry) entry = &allocateL2(address);
+        entry->line.address = address;
+        entry->line.state = State::Invalid;
+        entry->in_l1 = true;
+        l2.touch(*entry);
+    }
 
-                    // Print 2: Bus Response received
-                    string dataSource = response.data_from_memory ? "memory" : "CPU-" + to_string(response.core_id);
-                    cout << "CPU - " << id << ": Requester Bus Response Received | data: 0x" << hex << response.data << dec 
-                         << " | from: " << dataSource << endl;
-                    
-                    // Print 3: Requesting Cache-Line Transition
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(cache[index].state) << "]" << endl;
-                    
+    // On an L1 miss, look in the victim buffer and then the L2 before using the bus.
+    // Returns true on a hit, after which the access proceeds as an L1 hit.
+    bool fillFromPrivateLevels(int address, int index) {
+        CacheLine* pending = writebacks.find(address);
+        if (pending) {
+            // The refetch must see the written-back data: finish that write-back first
+            stats.wb_forced_drains++;
+            drainWriteBack(*pending, true);
+        }
+        return fillFromVictimBuffer(address, index) || fillFromL2(address, index);
+    }
+
+    // A victim buffer hit swaps the line with the L1 conflict victim, if there is one
+    bool fillFromVictimBuffer(int address, int index) {
+        CacheLine* hit = victims.find(address);
+        if (!hit) return false;
+        stats.victim_hits++;
+        stats.cycles += VICTIM_BUFFER_LATENCY;
+
+        CacheLine& l1 = cache[index];
+        if (l1.state != State::Invalid && l1.address == reserved_address) {
+            reserved_address = -1;
+            stats.reservations_evicted++;
+        }
+        swap(l1, *hit);
+        victims.touch(*hit);
+        noteL1Fill(address);
+        LOG("CPU - " << id << ": Victim buffer hit @ addr 0x" << hex << address << dec << " | swapped into L1 | state: " << stateToString(l1.state) << endl);
+        return true;
+    }
+
+    // An L2 hit moves the line up with its coherence state. The L1 makes room first,
+    // which in rare cases (a one-way L2 set, an LLC back-invalidation) costs the line.
+    bool fillFromL2(int address, int index) {
+        if (!l2.enabled()) return false;
+        PrivateL2::Entry* entry = l2.find(address);
+        if (entry && !entry->in_l1) {
+            l2.touch(*entry);
+            handleCacheEviction(address, index);
+            entry = l2.find(address);
+        }
+        if (!entry || entry->in_l1) {
+            stats.l2_misses++;
+            return false;
+        }
+        stats.l2_hits++;
+        stats.cycles += L2_LATENCY;
+
+        cache[index] = entry->line;
+        entry->line.state = State::Invalid;
+        entry->in_l1 = (l2.policy == L2Policy::Inclusive);
+        noteL1Fill(address);
+        LOG("CPU - " << id << ": L2 hit @ addr 0x" << hex << address << dec << " | moved to L1 | state: " << stateToString(cache[index].state) << endl);
+        return true;
+    }
+
+    // Perform atomic operation on cache value. Returns the prior value and, for CAS,
+    // whether the swap happened.
+    CpuResult performAtomicOperation(const CpuOp& op, const word_t& value, const int& cache_index, const word_t& expected_value = 0) {
+        word_t old_value = cache[cache_index].value;
+        CpuResult result = {old_value, true};
+        cache[cache_index].value = atomicALU(op, old_value, value, expected_value, result.success);
+        if (result.success) {
+            word_stores[cache[cache_index].address]++;
+        }
+        LOG("CPU - " << id << ": Performing atomic operation | type: " << cpuOpToString(op) 
+             << " | old value: 0x" << hex << old_value << dec 
+             << " | operand: 0x" << hex << value << dec 
+             << " | new value: 0x" << hex << cache[cache_index].value << dec << endl);
+        return result;
+    }
+
+    // Far atomic: the ALU runs at memory after one BusAtomic removes every cached copy,
+    // so the line does not migrate into this cache. A copy held here in S or O is
+    // dropped first (an O copy's dirty data goes to memory with the request).
+    CpuResult performFarAtomic(const CpuOp& op, const int& address, const word_t& value, const word_t& expected_value);
+
+    // Bulk operation over the words of [address, address + length): copy from a source
+    // range, set to value, or zero. Every word is an ordinary Read and Write (Store_NT
+    // with bulk_non_temporal) access, so each line gets its usual coherence transaction,
+    // but up to BULK_SNOOP_BATCH transactions share one bus arbitration and snoop.
+    // Ranges are clipped to memory; an overlapping copy runs in the safe direction.
+    CpuResult performBulkOperation(const CpuOp& op, int address, const word_t& value, const word_t& expected_value) {
+        long long length = static_cast<long long>(op == CpuOp::Mem_Zero ? value : expected_value);
+        int source = (op == CpuOp::Mem_Copy) ? static_cast<int>(value) : address;
+        word_t fill = (op == CpuOp::Mem_Set) ? value : 0;
+        long long words = length > 0 ? (length + 3) / 4 : 0;
+        words = min<long long>(words, (MEMORY_SIZE - max(address, source) + 3) / 4);
+        if (source < 0 || source >= MEMORY_SIZE || words < 0) words = 0;   // Nothing of the range lies in memory
+        CpuOp store = bulk_non_temporal ? CpuOp::Store_NT : CpuOp::Write;
+
+        if (op == CpuOp::Mem_Copy) {
+            LOG("CPU - " << id << ": Bulk " << cpuOpToString(op) << " @ addr 0x" << hex << address << " from 0x" << source << dec << " | " << words << " words" << endl);
+        } else {
+            LOG("CPU - " << id << ": Bulk " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << " | " << words << " words" << endl);
+        }
+        stats.bulk_operations++;
+        stats.bulk_words += words;
+        bulk_batching = true;
+        snoop_batch_left = 0;
+        bool backwards = (op == CpuOp::Mem_Copy && source < address && address < source + 4 * words);
+        for (long long k = 0; k < words; k++) {
+            int offset = static_cast<int>(4 * (backwards ? words - 1 - k : k));
+            word_t data = fill;
+            if (op == CpuOp::Mem_Copy) {
+                data = performAccess(CpuOp::Read, source + offset).value;
+            }
+            performAccess(store, address + offset, data);
+        }
+        bulk_batching = false;
+        return {0, true};
+    }
+
+    // Execute one CPU operation. Atomics return the prior value and a CAS success flag,
+    // so a simulated program needs no separate Read to see the result.
+    CpuResult cpu_operation(const CpuOp& op, const int& address, const word_t& value = 0, const word_t& expected_value = 0) {
+        // Lock the entire CPU operation to prevent thread interleaving. The uncontended
+        // path is a single try_lock; only a blocked acquisition is timed.
+        unique_lock<mutex> lock(operation_mutex, try_to_lock);
+        if (!lock.owns_lock()) {
+            auto wait_start = chrono::steady_clock::now();
+            lock.lock();
+            host.lock_wait_ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - wait_start).count();
+            host.lock_contended++;
+        }
+        host.lock_acquisitions++;
+
+        CpuResult result = isBulkOp(op) ? performBulkOperation(op, address, value, expected_value)
+                                        : performAccess(op, address, value, expected_value);
+        operationCompleted();
+        return result;
+    }
+
+    // One single-word access, under the operation lock
+    CpuResult performAccess(const CpuOp& op, const int& address, const word_t& value = 0, const word_t& expected_value = 0) {
+        stats.cycles += HIT_LATENCY;
+
+        LOG("========================================" << endl);
+        if (op == CpuOp::Write || op == CpuOp::Store_Conditional || op == CpuOp::Store_NT) {
+            LOG("CPU - " << id << ": Executing Instruction: " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << " | data: 0x" << hex << value << dec << endl);
+        } else {
+            LOG("CPU - " << id << ": Executing Instruction: " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << endl);
+        }
+        LOG("========================================" << endl);
+        
+        int index = getCacheIndex(address);
+        CpuResult result = {0, true};
+        
+        switch (op) {
+            case CpuOp::Read:
+            case CpuOp::Load_Linked:
+            case CpuOp::PrefetchW: {
+
+                // Check for cache hit: valid state AND matching address
+                bool is_hit = (cache[index].state != State::Invalid) && (cache[index].address == address);
+                countAccess(op, address, is_hit);
+                
+                // Print 1: CPU Request (Hit/Miss) with initial state
+                if (!is_hit) {
+                    LOG("CPU - " << id << ": Cache-MISS @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl);
+                } else {
+                    LOG("CPU - " << id << ": Cache-HIT @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl);
+                }
+                if (!is_hit) {
+                    prefetch_trigger = address;
+                    is_hit = fillFromPrivateLevels(address, index);
+                }
+                
+                if (!is_hit) {
+                    // Handle cache eviction with write-back for dirty data
+                    handleCacheEviction(address, index);
+                    
+                    // Save present state before bus operation
+                    State present_state = cache[index].state;
+
+                    // A read for ownership takes the line with BusRdX: E if the data came
+                    // from memory (M under MSI), M if a dirty copy supplied it
+                    bool for_ownership = readForOwnership(op, address);
+                    BusOp bus_op = for_ownership ? BusOp::BusRdX : BusOp::BusRd;
+                    
+                    // Print Bus Request
+                    LOG("CPU - " << id << ": Sending Bus Request | " << busOpToString(bus_op) << " @ addr 0x" << hex << address << dec << endl);
+
+                    // Issue BusRd transaction to the bus.
+                    BusResponse response = send_bus_operation(bus_op, address, id);
+                    countFill(response);
+                    
+                    // Update cache with fetched data
+                    cache[index].address = address;  // Store full address
+                    cache[index].value = response.data;
+                    if (for_ownership) {
+                        stats.rfo_reads++;
+                        setState(cache[index], response.data_from_memory && Protocol::has_exclusive ? State::Exclusive : State::Modified);
+                        upgrade_avoidable[address] = (response.present_state != State::Invalid);
+                    } else {
+                        setState(cache[index], response.requester_new_state);
+                    }
+                    noteL1Fill(address);
+
+                    // Print 2: Bus Response received
+                    LOG("CPU - " << id << ": Requester Bus Response Received | data: 0x" << hex << response.data << dec 
+                         << " | from: " << (response.data_from_memory ? string(response.data_from_llc ? "LLC" : "memory") : "CPU-" + to_string(response.core_id)) << endl);
+                    
+                    // Print 3: Requesting Cache-Line Transition
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(cache[index].state) << "]" << endl);
+                    
+                } else if (op == CpuOp::PrefetchW && (cache[index].state == State::Shared || cache[index].state == State::Owned || cache[index].state == State::Forward)) {
+                    // Read for ownership of a shared copy: take it over now rather than at the store
+                    State present_state = cache[index].state;
+                    LOG("CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl);
+                    send_bus_operation(BusOp::BusUpgr, address, id);
+                    setState(cache[index], State::Modified);
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state)
+                         << "->" << stateToString(State::Modified) << "]" << endl);
                 } else {
                     // Read Hit - no bus operation needed
                     // Print 2: No bus operation needed
-                    cout << "CPU - " << id << ": Local Cache Hit Received | data: 0x" << hex << cache[index].value << dec
-                         << " | from: local cache | state: " << stateToString(cache[index].state) << endl;
+                    LOG("CPU - " << id << ": Local Cache Hit Received | data: 0x" << hex << cache[index].value << dec
+                         << " | from: local cache | state: " << stateToString(cache[index].state) << endl);
                     
                     // Print 3: Requesting Cache-Line Transition (no change)
                     State present_state = cache[index].state;
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(present_state) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(present_state) << "]" << endl);
+                }
+                result.value = cache[index].value;
+                if (op == CpuOp::Load_Linked) {
+                    reserved_address = address;
+                    LOG("CPU - " << id << ": Reservation set @ addr 0x" << hex << address << dec << endl);
+                }
+                break;
+            }
+            case CpuOp::Store_Conditional: {
+                // Succeeds only while the reservation from this core's last Load_Linked holds
+                // and the L1 still has the line. Anything that drops the line should clear the
+                // reservation, but the line itself is checked too rather than trusted.
+                bool reserved = (reserved_address == address);
+                bool held = (cache[index].state != State::Invalid) && (cache[index].address == address);
+                reserved_address = -1;
+                if (!reserved || !held) {
+                    stats.sc_failures++;
+                    sc_failed_streak++;
+                    result.success = false;
+                    LOG("CPU - " << id << ": Store-conditional FAILED | " << (reserved ? "line no longer held" : "no reservation")
+                         << " @ addr 0x" << hex << address << dec << endl);
+                    break;
+                }
+                countAccess(op, address, true);
+                noteStore(address, cache[index], true);
+                result.value = cache[index].value;
+
+                State present_state = cache[index].state;
+                if (present_state == State::Shared || present_state == State::Owned || present_state == State::Forward) {
+                    LOG("CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl);
+                    send_bus_operation(BusOp::BusUpgr, address, id);
+                } else {
+                    LOG("CPU - " << id << ": No bus operation needed | already has exclusive ownership" << endl);
                 }
+                LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state)
+                     << "->" << stateToString(State::Modified) << "]" << endl);
+                cache[index].value = value;
+                setState(cache[index], State::Modified);
+                word_stores[address]++;
+
+                stats.sc_retries.add(static_cast<int>(min<unsigned long long>(sc_failed_streak, MAX_CORES - 1)));
+                sc_failed_streak = 0;
+                LOG("CPU - " << id << ": Store-conditional succeeded | value: 0x" << hex << value << dec << " | final state: " << stateToString(cache[index].state) << endl);
                 break;
             }
-            case CpuOp::Write: {
+            case CpuOp::Write:
+            case CpuOp::Store_NT: {
                 // Write operation: Check for cache hit, send BusRdX if miss, BusUpgr if Shared
+                // (a non-temporal store overwrites the whole line, so it misses with BusInv).
+                // Under write-update the other copies keep the line: a miss reads it with BusRd
+                // and a store to a shared line sends BusUpd instead.
+                bool update = op == CpuOp::Write && write_update[address];
                 
                 // Check for cache hit: valid state AND matching address
                 bool is_hit = (cache[index].state != State::Invalid) && (cache[index].address == address);
+                countAccess(op, address, is_hit);
                 
                 // Print 1: CPU Request (Hit/Miss) with initial state
                 if (!is_hit) {
-                    cout << "CPU - " << id << ": Cache-MISS @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl;
+                    LOG("CPU - " << id << ": Cache-MISS @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl);
                 } else {
-                    cout << "CPU - " << id << ": Cache-HIT @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl;
+                    LOG("CPU - " << id << ": Cache-HIT @ addr 0x" << hex << address << dec << " (index " << index << ") | initial state: " << stateToString(cache[index].state) << endl);
                 }
                 
                 if (!is_hit) {
+                    prefetch_trigger = address;
+                    is_hit = fillFromPrivateLevels(address, index);
+                }
+                noteStore(address, cache[index], is_hit);
+                if (is_hit) {
+                    result.value = cache[index].value;
+                }
+
+                if (!is_hit && op == CpuOp::Store_NT) {
+                    // The store replaces the whole line: claim it without fetching the old data
+                    handleCacheEviction(address, index);
+                    State present_state = cache[index].state;
+
+                    LOG("CPU - " << id << ": Sending Bus Request | BusInv @ addr 0x" << hex << address << dec << endl);
+                    send_bus_operation(BusOp::BusInv, address, id);
+
+                    cache[index].address = address;
+                    setState(cache[index], State::Modified);
+                    noteL1Fill(address);
+                    cache[index].value = value;
+
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state)
+                         << "->" << stateToString(cache[index].state) << "]" << endl);
+
+                } else if (!is_hit && update) {
+                    // Write-update miss: fetch the line like a read, then write it as a hit
+                    handleCacheEviction(address, index);
+                    State present_state = cache[index].state;
+
+                    LOG("CPU - " << id << ": Sending Bus Request | BusRd @ addr 0x" << hex << address << dec << endl);
+                    BusResponse response = send_bus_operation(BusOp::BusRd, address, id);
+                    countFill(response);
+
+                    cache[index].address = address;
+                    setState(cache[index], response.requester_new_state);
+                    noteL1Fill(address);
+                    result.value = response.data;
+
+                    LOG("CPU - " << id << ": Requester Bus Response Received | data: 0x" << hex << response.data << endl);
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state)
+                         << "->" << stateToString(cache[index].state) << "]" << endl);
+
+                    cache[index].value = value;
+                    if (cache[index].state == State::Exclusive) {
+                        LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(State::Exclusive)
+                             << "->" << stateToString(State::Modified) << "]" << endl);
+                        setState(cache[index], State::Modified);
+                    } else {
+                        updateSharers(cache[index]);
+                    }
+
+                } else if (update && (cache[index].state == State::Shared || cache[index].state == State::Owned
+                                      || cache[index].state == State::Forward)) {
+                    // Write-update hit on a line other caches may share: update them in place
+                    cache[index].value = value;
+                    updateSharers(cache[index]);
+
+                } else if (!is_hit) {
                     // Handle cache eviction with write-back for dirty data
                     handleCacheEviction(address, index);
                     
@@ -206,88 +1312,92 @@ public:
                     State present_state = cache[index].state;
                     
                     // Print Bus Request
-                    cout << "CPU - " << id << ": Sending Bus Request | BusRdX @ addr 0x" << hex << address << dec << endl;
+                    LOG("CPU - " << id << ": Sending Bus Request | BusRdX @ addr 0x" << hex << address << dec << endl);
                     
                     // Send bus operation and get response
                     BusResponse response = send_bus_operation(BusOp::BusRdX, address, id);
+                    countFill(response);
                     
                     // Update cache address and state 
                     cache[index].address = address;  // Store full address
-                    cache[index].state = response.requester_new_state;
+                    setState(cache[index], response.requester_new_state);
+                    noteL1Fill(address);
                     
                     // Fetch data from bus response first
                     cache[index].value = response.data;
+                    result.value = response.data;
 
-                    cout << "CPU - " << id << ": Requester Bus Response Received | data: 0x" << hex << response.data << endl;
+                    LOG("CPU - " << id << ": Requester Bus Response Received | data: 0x" << hex << response.data << endl);
                     
                     // Print 3: Requesting Cache-Line Transition (no bus response print needed for writes)
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(cache[index].state) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(cache[index].state) << "]" << endl);
                     
                     // Now write data to the cache line (overwrite fetched data)
                     cache[index].value = value;
                     
-                } else if (cache[index].state == State::Shared) {
-                    // Cache hit in Shared state: Send BusUpgr to invalidate other copies
+                } else if (cache[index].state == State::Shared || cache[index].state == State::Forward) {
+                    // Cache hit in Shared (or Forward) state: Send BusUpgr to invalidate other copies
                     // Shared state cannot be written directly - must invalidate all other copies first
                     State present_state = cache[index].state;
                     
                     // Print Bus Request
-                    cout << "CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl;
+                    LOG("CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl);
                     
                     // Send bus operation and get response
                     BusResponse response = send_bus_operation(BusOp::BusUpgr, address, id);
                     
                     // Print 2: Bus Response received (no data needed for BusUpgr)
-                    cout << "CPU - " << id << ": Requester Bus Response Received | BusUpgr completed" << endl;
+                    LOG("CPU - " << id << ": Requester Bus Response Received | BusUpgr completed" << endl);
                     
                     // Print 3: Requesting Cache-Line Transition
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(State::Modified) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(State::Modified) << "]" << endl);
                     
                     // Write to own cacheline and transition to Modified
                     cache[index].value = value;
-                    cache[index].state = State::Modified;
+                    setState(cache[index], State::Modified);
                     
                 } else if (cache[index].state == State::Exclusive) {
                     // Cache hit in Exclusive state: No bus operation needed (already has exclusive ownership)
                     State present_state = cache[index].state;
                     
-                    cout << "CPU - " << id << ": No bus operation needed | already has exclusive ownership" << endl;
+                    LOG("CPU - " << id << ": No bus operation needed | already has exclusive ownership" << endl);
                     
                     // Write to own cacheline and transition to Modified
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(State::Modified) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(State::Modified) << "]" << endl);
                     
                     cache[index].value = value;
-                    cache[index].state = State::Modified;
+                    setState(cache[index], State::Modified);
                 } else if (cache[index].state == State::Owned) {
                     // Cache hit in Owned state: Send BusUpgr to invalidate other copies, transition O->M
                     State present_state = cache[index].state;
                     
-                    cout << "CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl;
+                    LOG("CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl);
                     
                     // Send bus operation and get response
                     BusResponse response = send_bus_operation(BusOp::BusUpgr, address, id);
                     
                     // Print 2: Bus Response received (no data needed for BusUpgr)
-                    cout << "CPU - " << id << ": Requester Bus Response Received | BusUpgr completed" << endl;
+                    LOG("CPU - " << id << ": Requester Bus Response Received | BusUpgr completed" << endl);
                     
                     // Print 3: Requesting Cache-Line Transition
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(State::Modified) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(State::Modified) << "]" << endl);
                     
                     // Write to own cacheline and transition to Modified
                     cache[index].value = value;
-                    cache[index].state = State::Modified;
+                    setState(cache[index], State::Modified);
                     
                 } else if (cache[index].state == State::Modified) {
                     // Cache hit in Modified state: No bus operation needed (already has exclusive ownership)
-                    cout << "CPU - " << id << ": No bus operation needed | already Modified" << endl;                    
+                    LOG("CPU - " << id << ": No bus operation needed | already Modified" << endl);
                     cache[index].value = value;
                 }
                 
-                cout << "CPU - " << id << ": Write completed | value: 0x" << hex << value << dec << " | final state: " << stateToString(cache[index].state) << endl;
+                word_stores[address]++;
+                LOG("CPU - " << id << ": Write completed | value: 0x" << hex << value << dec << " | final state: " << stateToString(cache[index].state) << endl);
                 break;
             }
             // Atomic operations
@@ -303,8 +1413,20 @@ public:
             {
                 int index = getCacheIndex(address);
                 bool is_hit = (cache[index].address == address) && (cache[index].state != State::Invalid);
+                const CacheLine* held = findLine(address);
+                bool held_exclusive = held && (held->state == State::Modified || held->state == State::Exclusive);
+                if (atomic_policy.executeFar(address, id, held_exclusive)) {
+                    result = performFarAtomic(op, address, value, expected_value);
+                    break;
+                }
+                countAccess(op, address, is_hit);
+                if (!is_hit) {
+                    prefetch_trigger = address;
+                    is_hit = fillFromPrivateLevels(address, index);
+                }
+                noteStore(address, cache[index], is_hit);
                 
-                cout << "\n>>> CPU - " << id << ": ACQUIRED BUS LOCK | Executing Atomic Operation " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << endl;
+                LOG("\n>>> CPU - " << id << ": ACQUIRED BUS LOCK | Executing Atomic Operation " << cpuOpToString(op) << " @ addr 0x" << hex << address << dec << endl);
                 
                 if (!is_hit) {
                     // Cache miss - check for eviction and handle conflict miss
@@ -313,347 +1435,1586 @@ public:
                     // Cache miss: Send BusRdX to get exclusive ownership
                     State present_state = cache[index].state;
                     
-                    cout << "CPU - " << id << ": Sending Bus Request | BusRdX @ addr 0x" << hex << address << dec << endl;
+                    LOG("CPU - " << id << ": Sending Bus Request | BusRdX @ addr 0x" << hex << address << dec << endl);
                     
                     // Send bus operation and get response
                     BusResponse response = send_bus_operation(BusOp::BusRdX, address, id);
+                    countFill(response);
                     
                     // Update cache address and state (not the value - we'll write that below)
                     cache[index].address = address;  // Store full address
-                    cache[index].state = State::Modified;
+                    setState(cache[index], State::Modified);
+                    noteL1Fill(address);
                     
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(State::Modified) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(State::Modified) << "]" << endl);
                     
                     // Fetch data from response
                     cache[index].value = response.data;
 
                     // Perform atomic operation (write occurs here)
-                    performAtomicOperation(op, value, index, expected_value);
+                    result = performAtomicOperation(op, value, index, expected_value);
                     
                     // State is already Modified (from line 314)
                     
-                } else if (cache[index].state == State::Shared || cache[index].state == State::Owned) {
-                    // Cache hit in Shared or Owned state: Send BusUpgr to invalidate other copies
+                } else if (cache[index].state == State::Shared || cache[index].state == State::Owned || cache[index].state == State::Forward) {
+                    // Cache hit in Shared, Owned or Forward state: Send BusUpgr to invalidate other copies
                     State present_state = cache[index].state;
                     
-                    cout << "CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl;
+                    LOG("CPU - " << id << ": Sending Bus Request | BusUpgr @ addr 0x" << hex << address << dec << endl);
                     
                     // Send bus operation and get response
                     BusResponse response = send_bus_operation(BusOp::BusUpgr, address, id);
                     
                     // Perform atomic operation first (write occurs here)
-                    performAtomicOperation(op, value, index, expected_value);
+                    result = performAtomicOperation(op, value, index, expected_value);
                     
                     // Then transition to Modified state after atomic write completes
-                    cache[index].state = State::Modified;
+                    setState(cache[index], State::Modified);
                     
-                    cout << "CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
-                         << "->" << stateToString(State::Modified) << "]" << endl;
+                    LOG("CPU - " << id << ": Requesting Cache-Line Transition | [" << stateToString(present_state) 
+                         << "->" << stateToString(State::Modified) << "]" << endl);
                     
                 } else if (cache[index].state == State::Modified || cache[index].state == State::Exclusive) {
                     // Already have exclusive ownership
-                    cout << "CPU - " << id << ": No bus operation needed | already has exclusive ownership" << endl;
+                    LOG("CPU - " << id << ": No bus operation needed | already has exclusive ownership" << endl);
                     
                     // Perform atomic operation first (write occurs here)
-                    performAtomicOperation(op, value, index, expected_value);
+                    result = performAtomicOperation(op, value, index, expected_value);
                     
                     // Then transition to Modified state after atomic write completes
-                    cache[index].state = State::Modified;
+                    setState(cache[index], State::Modified);
                 }
                 
-                cout << "CPU - " << id << ": Atomic operation completed | value: 0x" << hex << cache[index].value << dec 
-                     << " | final state: " << stateToString(cache[index].state) << endl;
-                cout << "<<< CPU - " << id << ": RELEASED BUS LOCK\n" << endl;
+                LOG("CPU - " << id << ": Atomic operation completed | value: 0x" << hex << cache[index].value << dec 
+                     << " | final state: " << stateToString(cache[index].state) << endl);
+                LOG("<<< CPU - " << id << ": RELEASED BUS LOCK\n" << endl);
                 break;
             } 
+            case CpuOp::Mem_Copy:
+            case CpuOp::Mem_Set:
+            case CpuOp::Mem_Zero:
+                // cpu_operation sends bulk operations to performBulkOperation, which
+                // splits them into single-word accesses before they get here
+                assert(false && "bulk operation passed to performAccess");
+                break;
+        }
+
+        if (prefetcher.enabled()) {
+            issuePrefetches(index);
+        }
+        drainOldestWriteBack();
+        return result;
+    }
+
+    // Functional warming for sampled simulation: performAccess with only the L1 and
+    // memory (Bus::warmable). Tags, states, values and the reservation change exactly
+    // as in detail; nothing is counted, classified, prefetched, predicted or timed.
+    void warmAccess(CpuOp op, int address, word_t value, word_t expected);
+
+    // A warming snoop removed this core's copy
+    void warmInvalidate(CacheLine& line) {
+        line.state = State::Invalid;
+        if (line.address == reserved_address) reserved_address = -1;
+    }
+
+    // Let the bus run its periodic work (statistics export) after each operation
+    void operationCompleted();
+
+    BusResponse send_bus_operation(const BusOp& op, const int& address, const int& initiator_id, bool critical_path = true);
+
+    // Cycles a bus transaction takes, given where its data came from
+    unsigned long long busLatency(const BusOp& op, const BusResponse& response) const;
+
+};   // End of Processor class.
+
+// Bus class - manages all processors and bus operations
+class Bus {
+private:
+    mutex bus_mutex;  // Protect Bus operations from concurrent access
+    
+public:
+    array<Processor, NUM_PROCESSORS> processors;
+    HotLineProfiler* profiler;  // Optional, fed from broadcastBusOperation when set
+    StatsExporter* exporter;    // Optional, called every exporter->interval operations when set
+    TimeSeriesRecorder* timeseries;  // Optional, offered a snapshot after every operation when set
+    unsigned long long operations_completed;
+    unsigned long long elapsed_cycles;  // Simulated time: the furthest any core's cycle count has reached
+    LastLevelCache llc;                 // Shared cache below the bus; disabled unless configured
+
+    // Copy every core's counters into out[0..NUM_PROCESSORS-1]
+    void snapshotStats(CoreStats* out) const {
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            out[i] = processors[i].stats;
+        }
+    }
+
+    // Called at the end of every cpu_operation, with the operation lock held
+    void operationCompleted(unsigned long long core_cycles) {
+        operations_completed++;
+        if (core_cycles > elapsed_cycles) {
+            elapsed_cycles = core_cycles;
+        }
+        if (exporter && exporter->interval && operations_completed % exporter->interval == 0) {
+            exportStats();
+        }
+        if (timeseries && timeseries->due(operations_completed, elapsed_cycles)) {
+            snapshotStats(timeseries->beginSnapshot(operations_completed, elapsed_cycles));
+        }
+    }
+
+    bool exportStats() const {
+        CoreStats per_core[NUM_PROCESSORS];
+        snapshotStats(per_core);
+        return exporter->write(per_core, NUM_PROCESSORS, operations_completed);
+    }
+
+    // Sum of the per-core counters
+    CoreStats totalStats() const {
+        CoreStats total;
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            total += processors[i].stats;
         }
+        return total;
+    }
+
+    void printStats() const {
+        CoreStats per_core[NUM_PROCESSORS];
+        snapshotStats(per_core);
+        ::printStats(per_core, NUM_PROCESSORS);
+    }
+
+    // Check the coherence invariants over every cached copy: a line in M or E is the
+    // only valid copy, at most one cache holds a line in M or O, all copies of a line
+    // agree on its value, without a dirty owner that value matches memory (or the
+    // LLC), a core holds a line at most once across its levels, and an inclusive LLC
+    // holds every cached line with its sharer bit set. Prints each violation and
+    // returns how many were found. Call while no operation is in flight.
+    int checkInvariants() const {
+        int violations = 0;
+        vector<int> addresses;
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            const Processor& processor = processors[i];
+            for (int index = 0; index < CACHE_SIZE; index++) {
+                const CacheLine& line = processor.cache[index];
+                if (line.state != State::Invalid && (line.address / 4) % CACHE_SIZE != index) {
+                    cout << "INVARIANT: CPU-" << i << " holds addr 0x" << hex << line.address << dec << " at index " << index << endl;
+                    violations++;
+                }
+            }
+            processor.forEachLine([&](const CacheLine& line) {
+                if (processor.findLine(line.address) != &line) {
+                    cout << "INVARIANT: CPU-" << i << " holds addr 0x" << hex << line.address << dec << " at more than one level" << endl;
+                    violations++;
+                }
+                if (!Protocol::allows(line.state)) {
+                    cout << "INVARIANT: CPU-" << i << " holds addr 0x" << hex << line.address << dec << " in " << stateToString(line.state)
+                         << ", which " << PROTOCOL_NAME << " does not have" << endl;
+                    violations++;
+                }
+                if (llc.policy == LLCPolicy::Inclusive) {
+                    const LastLevelCache::Line* tracked = llc.find(line.address);
+                    if (!tracked || !(tracked->sharers & (uint64_t(1) << i))) {
+                        cout << "INVARIANT: CPU-" << i << " holds addr 0x" << hex << line.address << dec << " not tracked by the inclusive LLC" << endl;
+                        violations++;
+                    }
+                }
+                addresses.push_back(line.address);
+            });
+        }
+        sort(addresses.begin(), addresses.end());
+        addresses.erase(unique(addresses.begin(), addresses.end()), addresses.end());
+
+        for (int address : addresses) {
+            int copies = 0, exclusive = 0, owners = 0, forwarders = 0;
+            bool values_agree = true;
+            const CacheLine* first = nullptr;
+            for (int j = 0; j < NUM_PROCESSORS; j++) {
+                const CacheLine* other = processors[j].findLine(address);
+                if (!other) continue;
+                if (!first) first = other;
+                copies++;
+                if (other->state == State::Modified || other->state == State::Exclusive) exclusive++;
+                if (other->state == State::Modified || other->state == State::Owned) owners++;
+                if (other->state == State::Forward) forwarders++;
+                values_agree = values_agree && other->value == first->value;
+            }
+
+            string problem;
+            if (exclusive > 0 && copies > 1) problem = "M/E line has " + to_string(copies - 1) + " other copies";
+            else if (owners > 1) problem = to_string(owners) + " caches own the line";
+            else if (forwarders > 1) problem = to_string(forwarders) + " caches hold the line in F";
+            else if (!values_agree) problem = "copies disagree on the value";
+            else if (owners == 0 && first->value != backingValue(address)) problem = "clean line differs from memory";
+            if (!problem.empty()) {
+                cout << "INVARIANT: addr 0x" << hex << address << dec << ": " << problem << endl;
+                violations++;
+            }
+        }
+        return violations;
+    }
+
+    // Current value of a word: from the cache that owns it dirty, else from below the bus
+    word_t coherentValue(int address) const {
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            const CacheLine* line = processors[i].findLine(address);
+            if (line && (line->state == State::Modified || line->state == State::Owned)) {
+                return line->value;
+            }
+        }
+        return backingValue(address);
+    }
+
+    // The word as seen below the private caches: the LLC copy if there is one, else memory
+    word_t backingValue(int address) const {
+        const LastLevelCache::Line* line = llc.find(address);
+        return line ? line->value : memory[address];
+    }
+
+    // Read a word that no peer cache supplied, through the LLC when there is one.
+    // from_llc tells the requester which latency it paid.
+    word_t readMemory(int address, int core, bool& from_llc) {
+        from_llc = false;
+        if (!llc.enabled()) return memory[address];
+
+        CoreStats& stats = processors[core].stats;
+        LastLevelCache::Line* line = llc.find(address);
+        if (line) {
+            stats.llc_hits++;
+            from_llc = true;
+            word_t value = line->value;
+            if (llc.policy == LLCPolicy::Exclusive) {
+                // The line moves up into the private cache, which may take it clean
+                if (line->dirty) {
+                    memory[address] = value;
+                    stats.llc_writebacks++;
+                }
+                llc.remove(*line);
+            } else {
+                llc.touch(*line);
+            }
+            return value;
+        }
+        stats.llc_misses++;
+        word_t value = memory[address];
+        if (llc.policy != LLCPolicy::Exclusive) {
+            install(address, value, false, core);
+        }
+        return value;
+    }
+
+    // Write a word below the private caches: into the LLC (dirty) when there is one
+    void writeMemory(int address, word_t value, int core) {
+        if (!llc.enabled()) {
+            memory[address] = value;
+            return;
+        }
+        LastLevelCache::Line* line = llc.find(address);
+        if (line) {
+            line->value = value;
+            line->dirty = true;
+            llc.touch(*line);
+        } else {
+            install(address, value, true, core);
+        }
+    }
+
+    // Place a line that is not present in the LLC. An inclusive LLC first pulls the
+    // victim out of every private cache that may hold it, taking any dirty copy's
+    // data along. A dirty victim is written to memory on behalf of core.
+    LastLevelCache::Line& install(int address, word_t value, bool dirty, int core) {
+        LastLevelCache::Line victim;
+        LastLevelCache::Line& line = llc.allocate(address, value, dirty, victim);
+        if (victim.address == -1) return line;
+
+        if (llc.policy == LLCPolicy::Inclusive) {
+            for (int i = 0; i < NUM_PROCESSORS; i++) {
+                if ((victim.sharers & (uint64_t(1) << i)) && processors[i].backInvalidate(victim.address, victim.value)) {
+                    victim.dirty = true;
+                }
+            }
+        }
+        if (victim.dirty) {
+            memory[victim.address] = victim.value;
+            processors[core].stats.llc_writebacks++;
+        }
+        LOG("LLC: Evicted addr 0x" << hex << victim.address << dec << (victim.dirty ? " | written back to memory" : "") << endl);
+        return line;
+    }
+
+    // Core now holds a copy of address. An inclusive LLC must track every cached
+    // line, so it installs one it somehow lacks.
+    void addSharer(int address, int core, word_t value) {
+        LastLevelCache::Line* line = llc.find(address);
+        if (!line && llc.policy == LLCPolicy::Inclusive) line = &install(address, value, false, core);
+        if (line) line->sharers |= uint64_t(1) << core;
+    }
+
+    // Core's copy of address left its cache. An exclusive LLC keeps clean victims too.
+    void lineDropped(int address, int core) {
+        LastLevelCache::Line* line = llc.find(address);
+        if (line) {
+            line->sharers &= ~(uint64_t(1) << core);
+        } else if (llc.policy == LLCPolicy::Exclusive) {
+            install(address, memory[address], false, core);
+        }
+    }
+
+    // Return every cache, counter and memory word to the power-on state
+    void reset() {
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            processors[i] = Processor(i, this);
+        }
+        memory.fill(0);
+        word_stores.fill(0);
+        llc.clear();
+        operations_completed = 0;
+        elapsed_cycles = 0;
+    }
+
+    // Functional warming covers only the L1s and memory; any other level, write-update,
+    // the ownership predictor or an atomic that may run far needs the detailed path
+    bool warmable() const {
+        if (llc.enabled() || write_update_enabled || !atomic_policy.alwaysNear()) return false;
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            const Processor& p = processors[i];
+            if (p.victims.enabled() || p.l2.enabled() || p.writebacks.enabled() || p.ownership.enabled) return false;
+        }
+        return true;
+    }
+
+    // Warming counterpart of broadcastBusOperation: apply op's snoop rules to the other
+    // L1s and return the requester's data, recording which states answered
+    word_t warmSnoop(BusOp op, int address, int initiator_id, unsigned& seen_states) {
+        const unsigned dirty = (1u << static_cast<int>(State::Modified)) | (1u << static_cast<int>(State::Owned));
+        word_t data = 0;
+        bool supplied = false;
+        unsigned char answer_priority = 1;
+        seen_states = 0;
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            if (i == initiator_id) continue;
+            CacheLine& line = processors[i].cache[(address / 4) % CACHE_SIZE];
+            if (line.state == State::Invalid || line.address != address) continue;
+
+            const SnoopRule& rule = Protocol::snoop_table[static_cast<int>(op)][static_cast<int>(line.state)];
+            seen_states |= 1u << static_cast<int>(line.state);
+            if (rule.priority >= answer_priority) {
+                answer_priority = rule.priority;
+                supplied = rule.supplies;
+                data = line.value;
+            }
+            if (rule.writeback) memory[address] = line.value;
+            if (rule.next == State::Invalid) processors[i].warmInvalidate(line);
+            else line.state = rule.next;
+        }
+        // Ownership requests take clean data from memory, as in broadcastBusOperation
+        if ((op == BusOp::BusRdX || op == BusOp::BusAtomic) && !(seen_states & dirty)) supplied = false;
+        return supplied ? data : memory[address];
+    }
+
+    // Get mutex for external synchronization if needed
+    mutex& getMutex() { return bus_mutex; }
+    
+    Bus() : profiler(nullptr), exporter(nullptr), timeseries(nullptr), operations_completed(0), elapsed_cycles(0) {
+        // Initialize processors with reference to this bus
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            processors[i] = Processor(i, this);
+        }
+    }
+    
+    BusResponse broadcastBusOperation(const BusOp& op, const int& address, const int& initiator_id) {
+        // Note: Lock is already held by calling cpu_operation()
+        
+        // Special handling for BusWB: The initiator writes back its own cache line to memory
+        if (op == BusOp::BusWB) {
+            word_t data = processors[initiator_id].findLine(address)->value;
+            writeMemory(address, data, initiator_id);
+            lineDropped(address, initiator_id);
+            LOG("CPU - " << initiator_id << ": Write-back completed to memory | address: 0x" << hex << address 
+                 << " | data: 0x" << hex << data << dec << endl);
+            BusResponse response;
+            return response;
+        }
+
+        BusResponse response;
+        response.data = 0;  // Filled from the LLC or memory below unless a cache supplies it
+        response.data_from_memory = true;
+        response.data_from_llc = false;
+        response.requester_new_state = State::Invalid;
+        response.state_changed = false;
+        response.present_state = State::Invalid;
+        response.core_id = -1;  // -1 indicates data from memory
+
+        // What the other caches held, one bit per State, and the rank of the copy answering so far.
+        // Priority order: Modified > Owned > Exclusive > Forward > Shared > Memory
+        // This ensures we always get the most up-to-date data
+        unsigned seen_states = 0;
+        unsigned char answer_priority = 1;
+        int remote_copies = 0;           // Valid copies found in other caches
+        uint64_t invalidated_cores = 0;  // Remote copies removed by BusRdX/BusUpgr
+        bool ownership_moved = false;    // One of them was held in M, O or E
+
+        // The word a BusUpd carries is already in the initiator's line
+        word_t update_value = (op == BusOp::BusUpd) ? processors[initiator_id].findLine(address)->value : 0;
+
+        // An inclusive LLC knows which cores may hold the line; the rest need no snoop
+        uint64_t may_hold = ~uint64_t(0);
+        if (llc.policy == LLCPolicy::Inclusive) {
+            const LastLevelCache::Line* tracked = llc.find(address);
+            may_hold = tracked ? tracked->sharers : 0;
+        }
+
+        // Send bus operation to all other processors.
+        for (int i = 0; i < NUM_PROCESSORS; i++) {   
+            if (i == initiator_id) continue;    // Skip the initiator.
+            if (!(may_hold & (uint64_t(1) << i))) {
+                processors[initiator_id].stats.snoops_filtered++;
+                continue;
+            }
+            
+            Processor& other_processor = processors[i];
+            int cache_index = (address / 4) % CACHE_SIZE;  // Calculate cache index
+            CacheLine* snooped = other_processor.snoopLine(address);
+
+            // A filtered snoop, or a line holding another address, answers like an Invalid line
+            State snooped_state = (snooped && snooped->address == address) ? snooped->state : State::Invalid;
+            if (snooped_state == State::Invalid) continue;
+            CacheLine& other_cache_line = *snooped;
+            const SnoopRule& rule = Protocol::snoop_table[static_cast<int>(op)][static_cast<int>(snooped_state)];
+
+            other_processor.stats.snoop_hits[static_cast<int>(snooped_state)]++;
+            remote_copies++;
+            seen_states |= 1u << static_cast<int>(snooped_state);
+            if (rule.next == State::Invalid) {
+                invalidated_cores |= uint64_t(1) << i;
+                ownership_moved = ownership_moved || (snooped_state != State::Shared && snooped_state != State::Forward);
+            }
+
+            // A copy ranked at least as high as the current answer takes over the response
+            if (rule.priority >= answer_priority) {
+                answer_priority = rule.priority;
+                response.data = rule.supplies ? other_cache_line.value : response.data;
+                response.data_from_memory = !rule.supplies;
+                response.state_changed = rule.next != snooped_state;
+                response.present_state = snooped_state;
+                response.core_id = rule.named_supplier ? i : -1;
+            }
+
+            if (rule.writeback) {
+                writeMemory(address, other_cache_line.value, i);
+            }
+            if (rule.takes_update) {
+                other_processor.takeUpdate(other_cache_line, update_value);
+            }
+            LOG("CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(snooped_state) << endl);
+            if (rule.next != snooped_state) {
+                LOG("CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(snooped_state)
+                     << "->" << stateToString(rule.next) << "]" << endl);
+            }
+            if (rule.next == State::Invalid) {
+                other_processor.snoopInvalidate(other_cache_line);
+            } else {
+                other_processor.setState(other_cache_line, rule.next);
+            }
+        }   // End of for loop.
+
+        if (op == BusOp::BusRd) {
+            processors[initiator_id].stats.read_sharers.add(remote_copies);
+        } else if (op == BusOp::BusRdX || op == BusOp::BusUpgr || op == BusOp::BusAtomic || op == BusOp::BusInv) {
+            processors[initiator_id].stats.invalidation_fanout.add(remote_copies);
+        }
+
+        if (profiler && invalidated_cores) {
+            uint64_t cores = invalidated_cores | (uint64_t(1) << initiator_id);
+            profiler->recordInvalidation(address, cores);
+            if (ownership_moved) {
+                profiler->recordMigration(address, cores);
+            }
+        }
+        
+        // Set the final requester_new_state for the initiator based on snoop results
+        if (op == BusOp::BusRd) {
+            // BusRd: Read request. No sharers: Exclusive (Shared under MSI). Sharers exist:
+            // Shared, or Forward when the protocol has F and no M/O copy answers for the line.
+            // Note: In MOESI, Shared state may be dirty if there's an Owned copy
+            // Priority handling (Modified/Owned) ensures correct data source
+            bool found_modified = seen_states & (1u << static_cast<int>(State::Modified));
+            bool found_owned = seen_states & (1u << static_cast<int>(State::Owned));
+            bool other_copies = seen_states != 0;
+            bool owner_remains = found_owned || (found_modified && Protocol::has_owned);
+            response.requester_new_state = Protocol::readFillState(other_copies, owner_remains);
+        } else if (op == BusOp::BusRdX || op == BusOp::BusAtomic) {
+            // BusRdX: Read-for-Ownership request
+            if (seen_states & ((1u << static_cast<int>(State::Modified)) | (1u << static_cast<int>(State::Owned)))) {
+                // Data from Modified/Owned cache -> Modified state
+                response.requester_new_state = State::Modified;
+            } else {
+                // No data from cache, data from memory -> Modified state
+                response.requester_new_state = State::Modified;
+                response.data_from_memory = true;
+                response.core_id = -1;
+            }
+        }
+
+        if (op == BusOp::BusInv) {
+            response.requester_new_state = State::Modified;
+            response.data_from_memory = false;
+        }
+
+        if (op == BusOp::BusUpd) {
+            // The writer owns the updated line, or writes it through when the protocol has no O
+            response.requester_new_state = Protocol::updateState(remote_copies != 0);
+            response.data = update_value;
+            response.data_from_memory = false;
+            if (remote_copies != 0 && !Protocol::has_owned) {
+                writeMemory(address, update_value, initiator_id);
+            }
+        }
+
+        if (op != BusOp::BusUpgr && response.data_from_memory) {
+            response.data = readMemory(address, initiator_id, response.data_from_llc);
+        }
+
+        // Keep the LLC's sharer bits in step: invalidated copies are gone, a fill adds one.
+        // An exclusive LLC gives up its copy to a BusInv as it would to a fill; the
+        // data is stale, so it is dropped without a write-back.
+        if (llc.enabled()) {
+            LastLevelCache::Line* line = llc.find(address);
+            if (line) line->sharers &= ~invalidated_cores;
+            if (op == BusOp::BusInv && line && llc.policy == LLCPolicy::Exclusive) {
+                llc.remove(*line);
+            } else if (op == BusOp::BusInv) {
+                addSharer(address, initiator_id, backingValue(address));
+            } else if (op == BusOp::BusRd || op == BusOp::BusRdX) {
+                addSharer(address, initiator_id, response.data);
+            }
+        }
+        
+        return response;
+    }
+};
+
+void Processor::operationCompleted() {
+    bus->operationCompleted(stats.cycles);
+}
+
+// Implementation of Processor::send_bus_operation
+BusResponse Processor::send_bus_operation(const BusOp& op, const int& address, const int& initiator_id, bool critical_path) {
+    // Note: Lock is already held by calling cpu_operation()
+    stats.bus_issued[static_cast<int>(op)]++;
+    BusResponse response = bus->broadcastBusOperation(op, address, initiator_id);
+    if (critical_path) {
+        unsigned long long latency = busLatency(op, response);
+        if (bulk_batching && snoop_batch_left > 0) {
+            // Rides in the current batch: arbitration and snoop are already paid for
+            latency -= BUS_LATENCY;
+            snoop_batch_left--;
+            stats.batched_snoops++;
+        } else if (bulk_batching) {
+            snoop_batch_left = BULK_SNOOP_BATCH - 1;
+        }
+        stats.cycles += latency;
+    }
+    return response;
+}
+
+unsigned long long Processor::busLatency(const BusOp& op, const BusResponse& response) const {
+    unsigned long long latency = BUS_LATENCY;
+    if (op == BusOp::BusWB) {
+        latency += bus->llc.enabled() ? LLC_LATENCY : MEMORY_LATENCY;
+    } else if (op == BusOp::BusRd || op == BusOp::BusRdX) {
+        if (!response.data_from_memory) latency += CACHE_TO_CACHE_LATENCY;
+        else latency += response.data_from_llc ? LLC_LATENCY : MEMORY_LATENCY;
+    } else if (op == BusOp::BusAtomic) {
+        latency += FAR_ATOMIC_LATENCY;
+    } else if (op == BusOp::BusUpd && !Protocol::has_owned && response.requester_new_state != State::Modified) {
+        latency += bus->llc.enabled() ? LLC_LATENCY : MEMORY_LATENCY;   // The update is written through
+    }
+    return latency;
+}
+
+void Processor::cleanLineDropped(int address) {
+    bus->lineDropped(address, id);
+}
+
+// Functional warming: the detailed access reduced to its L1 tag, state, data and
+// reservation changes. Misses and upgrades snoop through Bus::warmSnoop, and a
+// dirty victim is written straight to memory.
+void Processor::warmAccess(CpuOp op, int address, word_t value, word_t expected) {
+    const unsigned dirty = (1u << static_cast<int>(State::Modified)) | (1u << static_cast<int>(State::Owned));
+    CacheLine& line = cache[getCacheIndex(address)];
+    bool is_hit = (line.state != State::Invalid) && (line.address == address);
+    if (op == CpuOp::Store_Conditional) {
+        bool reserved = (reserved_address == address);
+        reserved_address = -1;
+        if (!reserved || !is_hit) return;
+    }
+
+    bool is_store = op != CpuOp::Read && op != CpuOp::Load_Linked && op != CpuOp::PrefetchW;
+    bool for_ownership = is_store || op == CpuOp::PrefetchW;
+    unsigned seen = 0;
+    if (!is_hit) {
+        // Evict: a dirty victim goes straight to memory
+        if (line.state != State::Invalid) {
+            if (line.address == reserved_address) reserved_address = -1;
+            if (line.state == State::Modified || line.state == State::Owned) memory[line.address] = line.value;
+            line.state = State::Invalid;
+        }
+        BusOp bus_op = (op == CpuOp::Store_NT) ? BusOp::BusInv : for_ownership ? BusOp::BusRdX : BusOp::BusRd;
+        line.value = bus->warmSnoop(bus_op, address, id, seen);
+        line.address = address;
+        if (bus_op == BusOp::BusRd) {
+            bool owner_remains = (seen & (1u << static_cast<int>(State::Owned)))
+                                 || ((seen & (1u << static_cast<int>(State::Modified))) && Protocol::has_owned);
+            line.state = Protocol::readFillState(seen != 0, owner_remains);
+        } else if (op == CpuOp::PrefetchW && !(seen & dirty) && Protocol::has_exclusive) {
+            line.state = State::Exclusive;
+        } else {
+            line.state = State::Modified;
+        }
+    } else if (for_ownership && (line.state == State::Shared || line.state == State::Owned || line.state == State::Forward)) {
+        bus->warmSnoop(BusOp::BusUpgr, address, id, seen);
+        line.state = State::Modified;
+    }
+
+    if (is_store) {
+        bool success;
+        line.value = isAtomicOp(op) ? atomicALU(op, line.value, value, expected, success) : value;
+        line.state = State::Modified;
+    } else if (op == CpuOp::Load_Linked) {
+        reserved_address = address;
+    }
+}
+
+// Far atomic: the ALU runs at memory after one BusAtomic removes every cached copy,
+// so the line does not migrate into this cache. A copy held here in S or O is
+// dropped first (an O copy's dirty data goes to memory with the request).
+CpuResult Processor::performFarAtomic(const CpuOp& op, const int& address, const word_t& value, const word_t& expected_value) {
+    CacheLine* copy = findLine(address);
+    if (copy) {
+        CacheLine& line = *copy;
+        if (line.state == State::Owned) {
+            bus->writeMemory(address, line.value, id);
+        }
+        LOG("CPU - " << id << ": Dropping local copy for far atomic | [" << stateToString(line.state) << "->" << stateToString(State::Invalid) << "]" << endl);
+        if (address == reserved_address) {
+            reserved_address = -1;
+            stats.reservations_evicted++;
+        }
+        setState(line, State::Invalid);
+        bus->lineDropped(address, id);
+    }
+
+    LOG("CPU - " << id << ": Sending Bus Request | BusAtomic @ addr 0x" << hex << address << dec << endl);
+    BusResponse response = send_bus_operation(BusOp::BusAtomic, address, id);
+
+    CpuResult result = {response.data, true};
+    word_t new_value = atomicALU(op, response.data, value, expected_value, result.success);
+    bus->writeMemory(address, new_value, id);
+    if (result.success) {
+        word_stores[address]++;
+    }
+    stats.far_atomics++;
+    LOG("CPU - " << id << ": Far atomic executed at memory | type: " << cpuOpToString(op)
+         << " | old value: 0x" << hex << response.data << dec
+         << " | operand: 0x" << hex << value << dec
+         << " | new value: 0x" << hex << new_value << dec << endl);
+    return result;
+}
+
+// ============================================
+// TRACE REPLAY
+// ============================================
+
+// One access from a trace file. Each non-empty line of a trace reads
+//   <cpu> <op> <address> [value] [expected]
+// where <op> is a cpuOpToString name and numbers are decimal or 0x-prefixed hex.
+// Lines starting with '#' are comments.
+struct TraceRecord {
+    int cpu;
+    CpuOp op;
+    int address;
+    word_t value;
+    word_t expected;
+};
+
+class TraceReader {
+private:
+    ifstream in;
+    string path;
+    unsigned long long line_number;
+    bool malformed;
+
+    bool reject(const string& reason) {
+        cerr << path << ":" << line_number << ": " << reason << endl;
+        malformed = true;
+        return false;
+    }
+
+public:
+    explicit TraceReader(const string& path) : in(path), path(path), line_number(0), malformed(false) {}
+
+    bool isOpen() const { return in.is_open(); }
+
+    // True if reading stopped on a bad line rather than at end of file
+    bool failed() const { return malformed; }
+
+    // Read the next record. Returns false at end of trace or on a malformed line.
+    bool next(TraceRecord& record) {
+        string line;
+        while (getline(in, line)) {
+            line_number++;
+            const char* p = line.c_str();
+            while (isspace(*p)) p++;
+            if (*p == '\0' || *p == '#') continue;
+
+            char* end;
+            long long fields[4] = {0, 0, 0, 0};  // cpu, address, value, expected
+            fields[0] = strtoll(p, &end, 0);
+            if (end == p) return reject("expected a cpu id");
+            p = end;
+            while (isspace(*p)) p++;
+
+            const char* op_begin = p;
+            while (*p != '\0' && !isspace(*p)) p++;
+            if (!stringToCpuOp(string(op_begin, p), record.op)) return reject("unknown operation '" + string(op_begin, p) + "'");
+
+            int count = 1;
+            for (; count < 4; count++) {
+                // Operands parse as unsigned so full-width hex words such as 0xffffffffffffffff are accepted
+                fields[count] = count < 2 ? strtoll(p, &end, 0) : static_cast<long long>(strtoull(p, &end, 0));
+                if (end == p) break;
+                p = end;
+            }
+            if (count < 2) return reject("expected an address");
+
+            if (fields[0] < 0 || fields[0] >= NUM_PROCESSORS) return reject("cpu id out of range");
+            if (fields[1] < 0 || fields[1] >= MEMORY_SIZE) return reject("address out of range");
+            record.cpu = static_cast<int>(fields[0]);
+            record.address = static_cast<int>(fields[1]);
+            record.value = static_cast<word_t>(fields[2]);
+            record.expected = static_cast<word_t>(fields[3]);
+            return true;
+        }
+        return false;
+    }
+};
+
+void executeTraceRecord(Bus& bus, const TraceRecord& record) {
+    bus.processors[record.cpu].cpu_operation(record.op, record.address, record.value, record.expected);
+}
+
+// Replay every record of a trace in detail
+bool runTraceReplay(Bus& bus, const string& path) {
+    TraceReader reader(path);
+    if (!reader.isOpen()) {
+        cerr << "ERROR: cannot open trace " << path << endl;
+        return false;
+    }
+
+    unsigned long long accesses = 0;
+    TraceRecord record;
+    while (reader.next(record)) {
+        executeTraceRecord(bus, record);
+        accesses++;
+    }
+
+    unsigned long long misses = bus.totalStats().totalMisses();
+    cout << dec << "\n=== TRACE REPLAY ===\n";
+    cout << "Trace: " << path << " | protocol: " << PROTOCOL_NAME << endl;
+    cout << "Accesses: " << accesses << endl;
+    cout << "Misses: " << misses << " (" << (accesses ? 100.0 * misses / accesses : 0.0) << "%)" << endl;
+    bus.printStats();
+    return !reader.failed();
+}
+
+// ============================================
+// SYNTHETIC WORKLOADS
+// ============================================
+
+// Run ops_per_core generated accesses on every core, interleaved round-robin
+void runWorkload(Bus& bus, const WorkloadConfig& config, unsigned long long ops_per_core) {
+    vector<WorkloadGenerator> generators;
+    for (int i = 0; i < NUM_PROCESSORS; i++) {
+        generators.push_back(WorkloadGenerator(config, i));
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (unsigned long long n = 0; n < ops_per_core; n++) {
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            Access access = generators[i].next();
+            bus.processors[i].cpu_operation(access.op, access.address, access.value, access.expected);
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    unsigned long long accesses = ops_per_core * NUM_PROCESSORS;
+    unsigned long long misses = bus.totalStats().totalMisses();
+    cout << dec << "\n=== SYNTHETIC WORKLOAD ===\n";
+    cout << "Pattern: " << patternToString(config.pattern) << " | seed: " << config.seed << " | protocol: " << PROTOCOL_NAME << endl;
+    cout << "Accesses: " << accesses << " (" << ops_per_core << " per core)" << endl;
+    cout << "Misses: " << misses << " (" << (accesses ? 100.0 * misses / accesses : 0.0) << "%)" << endl;
+    cout << "Host rate: " << (seconds > 0 ? accesses / seconds : 0.0) << " ops/s" << endl;
+    bus.printStats();
+}
+
+// Write the same interleaved stream as a trace instead of simulating it
+bool writeWorkloadTrace(const string& path, const WorkloadConfig& config, unsigned long long ops_per_core) {
+    ofstream out(path);
+    if (!out.is_open()) {
+        cerr << "ERROR: cannot write trace " << path << endl;
+        return false;
+    }
+    vector<WorkloadGenerator> generators;
+    for (int i = 0; i < NUM_PROCESSORS; i++) {
+        generators.push_back(WorkloadGenerator(config, i));
+    }
+
+    out << "# " << patternToString(config.pattern) << " workload, seed " << config.seed
+        << ", " << ops_per_core << " accesses per core\n";
+    for (unsigned long long n = 0; n < ops_per_core; n++) {
+        for (int i = 0; i < NUM_PROCESSORS; i++) {
+            writeTraceLine(out, i, generators[i].next());
+        }
+    }
+    out.close();
+    if (!out) {
+        cerr << "ERROR: failed writing trace " << path << endl;
+        return false;
+    }
+    cout << "Wrote " << ops_per_core * NUM_PROCESSORS << " accesses to " << path << endl;
+    return true;
+}
+
+// Stress mode: one host thread per simulated core, each driving its own workload
+// generator through cpu_operation, all started together. Reports host throughput
+// and operation lock contention, then checks the coherence invariants.
+bool runStress(Bus& bus, WorkloadConfig config, int threads, unsigned long long ops_per_thread) {
+    config.num_cores = threads;
+    atomic<bool> start(false);
+    vector<thread> workers;
+    vector<double> thread_seconds(threads, 0.0);
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(thread([&bus, &config, &start, &thread_seconds, i, ops_per_thread]() {
+            WorkloadGenerator generator(config, i);
+            Processor& processor = bus.processors[i];
+            while (!start.load(memory_order_acquire)) {
+                this_thread::yield();
+            }
+            auto begin = chrono::steady_clock::now();
+            for (unsigned long long n = 0; n < ops_per_thread; n++) {
+                Access access = generator.next();
+                processor.cpu_operation(access.op, access.address, access.value, access.expected);
+            }
+            thread_seconds[i] = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        }));
+    }
+
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+    unsigned long long total_ops = ops_per_thread * threads;
+    cout << dec << "\n=== STRESS ===\n";
+    cout << "Pattern: " << patternToString(config.pattern) << " | seed: " << config.seed
+         << " | threads: " << threads << " | cores: " << NUM_PROCESSORS << " | protocol: " << PROTOCOL_NAME << endl;
+    cout << "Operations: " << total_ops << " in " << seconds << " s | " << (seconds > 0 ? total_ops / seconds : 0.0) << " ops/s" << endl;
+    cout << left << setw(8) << "Thread" << right << setw(14) << "Ops" << setw(14) << "Ops/s"
+         << setw(12) << "Contended" << setw(14) << "Wait ms" << setw(12) << "Wait %" << endl;
+    unsigned long long total_contended = 0;
+    unsigned long long total_wait_ns = 0;
+    for (int i = 0; i < threads; i++) {
+        const HostCounters& host = bus.processors[i].host;
+        total_contended += host.lock_contended;
+        total_wait_ns += host.lock_wait_ns;
+        cout << left << setw(8) << ("CPU-" + to_string(i)) << right << setw(14) << ops_per_thread
+             << setw(14) << (thread_seconds[i] > 0 ? ops_per_thread / thread_seconds[i] : 0.0)
+             << setw(11) << (host.lock_acquisitions ? 100.0 * host.lock_contended / host.lock_acquisitions : 0.0) << "%"
+             << setw(14) << host.lock_wait_ns / 1e6
+             << setw(11) << (thread_seconds[i] > 0 ? 100.0 * host.lock_wait_ns / 1e9 / thread_seconds[i] : 0.0) << "%" << endl;
+    }
+    cout << "Lock: " << total_contended << " contended acquisitions, " << total_wait_ns / 1e6 << " ms total wait" << endl;
+
+    int violations = bus.checkInvariants();
+    cout << "Coherence invariants: " << (violations == 0 ? "OK" : to_string(violations) + " violations") << endl;
+    return violations == 0;
+}
+
+// Parse "R,W,A" operation weights
+bool parseMix(const string& text, WorkloadConfig& config) {
+    double weights[3];
+    const char* p = text.c_str();
+    for (int i = 0; i < 3; i++) {
+        char* end;
+        weights[i] = strtod(p, &end);
+        if (end == p || weights[i] < 0) return false;
+        p = end;
+        if (i < 2) {
+            if (*p != ',') return false;
+            p++;
+        }
+    }
+    if (*p != '\0' || weights[0] + weights[1] + weights[2] <= 0) return false;
+    config.read_weight = weights[0];
+    config.write_weight = weights[1];
+    config.atomic_weight = weights[2];
+    return true;
+}
+
+// ============================================
+// SAMPLED SIMULATION
+// ============================================
+
+// Systematic sampling: the last `window` accesses of every `period` are measured,
+// the rest only functionally warm the caches. Warming runs Processor::warmAccess and
+// Bus::warmSnoop, which keep tags, states, data and reservations exact but log,
+// count and time nothing. When Bus::warmable() is false (any level beyond the L1s,
+// write-update, ownership prediction or far atomics), and for bulk operations,
+// warming falls back to the detailed path. Per-window results are extrapolated to
+// the whole trace with 95% confidence intervals.
+struct SamplingConfig {
+    unsigned long long period;
+    unsigned long long window;
+
+    SamplingConfig() : period(100000), window(1000) {}
+};
+
+// Running mean and variance of per-window measurements (Welford's method)
+struct SampleStatistic {
+    unsigned long long n;
+    double mean;
+    double m2;
+
+    SampleStatistic() : n(0), mean(0.0), m2(0.0) {}
+
+    void add(double x) {
+        n++;
+        double delta = x - mean;
+        mean += delta / n;
+        m2 += delta * (x - mean);
     }
 
-    BusResponse send_bus_operation(const BusOp& op, const int& address, const int& initiator_id);
+    double variance() const { return n > 1 ? m2 / (n - 1) : 0.0; }
 
-};   // End of Processor class.
+    // Half-width of the 95% confidence interval of the mean (Student's t below 30 samples)
+    double confidence95() const {
+        static const double t_table[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+        };
+        if (n < 2) return 0.0;
+        double t = (n - 1 <= 29) ? t_table[n - 2] : 1.96;
+        return t * sqrt(variance() / n);
+    }
+};
 
-// Bus class - manages all processors and bus operations
-class Bus {
-private:
-    mutex bus_mutex;  // Protect Bus operations from concurrent access
-    
-public:
-    array<Processor, NUM_PROCESSORS> processors;
-    
-    // Get mutex for external synchronization if needed
-    mutex& getMutex() { return bus_mutex; }
-    
-    Bus() {
-        // Initialize processors with reference to this bus
-        for (int i = 0; i < NUM_PROCESSORS; i++) {
-            processors[i] = Processor(i, this);
-        }
+bool runSampledSimulation(Bus& bus, const string& path, const SamplingConfig& config) {
+    if (config.window == 0 || config.window > config.period) {
+        cerr << "ERROR: sampling window must be between 1 and the sampling period" << endl;
+        return false;
     }
-    
-    BusResponse broadcastBusOperation(const BusOp& op, const int& address, const int& initiator_id) {
-        // Note: Lock is already held by calling cpu_operation()
-        
-        // Special handling for BusWB: The initiator writes back its own cache line to memory
-        if (op == BusOp::BusWB) {
-            memory[address] = processors[initiator_id].cache[(address / 4) % CACHE_SIZE].value;
-            cout << "CPU - " << initiator_id << ": Write-back completed to memory | address: 0x" << hex << address 
-                 << " | data: 0x" << hex << processors[initiator_id].cache[(address / 4) % CACHE_SIZE].value << dec << endl;
-            BusResponse response;
-            return response;
+    TraceReader reader(path);
+    if (!reader.isOpen()) {
+        cerr << "ERROR: cannot open trace " << path << endl;
+        return false;
+    }
+
+    const BusOp traffic_ops[] = {BusOp::BusRd, BusOp::BusRdX, BusOp::BusUpgr, BusOp::BusWB,
+                                 BusOp::BusAtomic, BusOp::BusInv, BusOp::BusUpd};
+    const unsigned long long window_start = config.period - config.window;
+    const bool warm_functional = bus.warmable();
+
+    SampleStatistic miss_rate;
+    array<SampleStatistic, NUM_BUS_OPS> bus_rate;
+    CoreStats before;
+    unsigned long long accesses = 0;
+    TraceRecord record;
+
+    while (reader.next(record)) {
+        unsigned long long position = accesses % config.period;
+        accesses++;
+        if (position < window_start) {
+            // Functional warming. Bulk operations, and hierarchies the warming path
+            // does not model, still run in detail; their counts fall outside the windows.
+            if (warm_functional && !isBulkOp(record.op)) {
+                bus.processors[record.cpu].warmAccess(record.op, record.address, record.value, record.expected);
+            } else {
+                executeTraceRecord(bus, record);
+            }
+            continue;
+        }
+        if (position == window_start) {
+            before = bus.totalStats();
+        }
+        executeTraceRecord(bus, record);
+        if (position == config.period - 1) {
+            CoreStats after = bus.totalStats();
+            miss_rate.add(static_cast<double>(after.totalMisses() - before.totalMisses()) / config.window);
+            for (BusOp op : traffic_ops) {
+                int i = static_cast<int>(op);
+                bus_rate[i].add(static_cast<double>(after.bus_issued[i] - before.bus_issued[i]) / config.window);
+            }
         }
+    }
 
-        BusResponse response;
-        response.data = memory[address];  // Default to memory data
-        response.data_from_memory = true;
-        response.requester_new_state = State::Invalid;
-        response.state_changed = false;
-        response.present_state = State::Invalid;
-        response.core_id = -1;  // -1 indicates data from memory
+    cout << dec << "\n=== SAMPLED SIMULATION ===\n";
+    cout << "Trace: " << path << " | protocol: " << PROTOCOL_NAME << endl;
+    cout << "Accesses: " << accesses << " | sampling units: " << miss_rate.n
+         << " x " << config.window << " accesses every " << config.period << endl;
+    if (miss_rate.n == 0) {
+        cout << "Trace shorter than one sampling period - nothing measured" << endl;
+        return !reader.failed();
+    }
+    cout << "Miss rate: " << 100.0 * miss_rate.mean << "% +/- " << 100.0 * miss_rate.confidence95() << "% (95% CI)" << endl;
+    cout << "Estimated misses: " << miss_rate.mean * accesses << " +/- " << miss_rate.confidence95() * accesses << endl;
+    for (BusOp op : traffic_ops) {
+        const SampleStatistic& rate = bus_rate[static_cast<int>(op)];
+        cout << "Estimated " << busOpToString(op) << ": " << rate.mean * accesses << " +/- " << rate.confidence95() * accesses
+             << " (" << rate.mean << " per access)" << endl;
+    }
+    return !reader.failed();
+}
 
-        // Track if we found any sharers
-        // Priority order: Modified > Owned > Exclusive > Shared > Memory
-        // This ensures we always get the most up-to-date data
-        bool found_sharer = false;
-        bool found_exclusive = false;
-        bool found_modified = false;
-        bool found_owned = false;
+// ============================================
+// MICROBENCHMARKS
+// ============================================
 
-        // Send bus operation to all other processors.
-        for (int i = 0; i < NUM_PROCESSORS; i++) {   
-            if (i == initiator_id) continue;    // Skip the initiator.
-            
-            Processor& other_processor = processors[i];
-            int cache_index = (address / 4) % CACHE_SIZE;  // Calculate cache index
-            CacheLine& other_cache_line = other_processor.cache[cache_index];
+// Put a line straight into a cache, bypassing the protocol, to set up a benchmark
+void placeLine(Bus& bus, int cpu, int address, word_t value, State state) {
+    CacheLine& line = bus.processors[cpu].cache[(address / 4) % CACHE_SIZE];
+    line.address = address;
+    line.value = value;
+    line.state = state;
+    if (state != State::Invalid) bus.addSharer(address, cpu, value);
+}
 
-            // Check if this cache line actually contains the requested address
-            bool address_match = (other_cache_line.address == address);
+struct BenchmarkConfig {
+    unsigned long long iterations;
+    int repetitions;
 
-            switch (op) {
-            case BusOp::BusRd: // Read request from initiator (P_i)
-                // Priority order: Modified > Owned > Exclusive > Shared > Invalid
-                // Only respond if address matches AND state is valid
-                
-                // Modified (highest priority) - always overwrites response
-                if (other_cache_line.state == State::Modified && address_match) {
-                    found_modified = true;
-                    response.data = other_cache_line.value;
-                    response.data_from_memory = false;
-                    response.state_changed = true;
-                    response.requester_new_state = State::Owned;
-                    response.present_state = State::Modified;
-                    response.core_id = i;
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Modified) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Modified) 
-                         << "->" << stateToString(State::Owned) << "]" << endl;
-                    other_cache_line.state = State::Owned;
-                } 
-                // Owned - second priority, only if no Modified found
-                else if (other_cache_line.state == State::Owned && address_match) {
-                    found_owned = true;
-                    if (!found_modified) {
-                        response.data = other_cache_line.value;
-                        response.data_from_memory = false;
-                        response.requester_new_state = State::Owned;
-                        response.state_changed = false;
-                        response.present_state = State::Owned;
-                        response.core_id = i;
-                    }
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Owned) << endl;
-                    other_cache_line.state = State::Owned;
-                } 
-                // Exclusive - third priority, only if no Modified or Owned found
-                else if (other_cache_line.state == State::Exclusive && address_match) {
-                    found_exclusive = true;
-                    if (!found_modified && !found_owned) {
-                        // Exclusive state: Data is consistent with memory, read from memory
-                        response.data = other_cache_line.value;
-                        response.data_from_memory = false;
-                        response.state_changed = true;
-                        response.requester_new_state = State::Shared;
-                        response.present_state = State::Exclusive;
-                        response.core_id = -1;  // Data from memory
-                        cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Exclusive) << endl;
-                        cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Exclusive) 
-                             << "->" << stateToString(State::Shared) << "]" << endl;
-                    }
-                    other_cache_line.state = State::Shared;
-                } 
-                // Shared - fourth priority, only if no cache data found yet
-                else if (other_cache_line.state == State::Shared && address_match) {
-                    found_sharer = true;
-                    if (!found_modified && !found_owned && !found_exclusive) {
-                        // Shared state: Check if any cache has Owned state to determine data source
-                        // If no Owned cache exists, memory is up to date
-                        // If Owned exists, data will come from that cache (higher priority already handled)
-                        response.data = memory[address];
-                        response.data_from_memory = true;
-                        response.requester_new_state = State::Shared;
-                        response.state_changed = false;
-                        response.present_state = State::Shared;
-                        response.core_id = -1;  // Data from memory
-                    }
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Shared) << endl;
-                } 
-                // Invalid (lowest priority) - no action needed
-                else if (other_cache_line.state == State::Invalid && address_match) {
-                    // No action needed
+    BenchmarkConfig() : iterations(200000), repetitions(5) {}
+};
+
+// Time `body` over config.iterations calls, after a warm-up of a tenth as many,
+// config.repetitions times. Reports the median and best ns per call.
+template <typename Body>
+void runBenchmark(const string& name, const BenchmarkConfig& config, Body body) {
+    for (unsigned long long i = 0; i < config.iterations / 10; i++) body();
+
+    vector<double> ns_per_op;
+    for (int rep = 0; rep < config.repetitions; rep++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < config.iterations; i++) body();
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        double ns = chrono::duration<double, nano>(end - start).count();
+        ns_per_op.push_back(ns / config.iterations);
+    }
+    sort(ns_per_op.begin(), ns_per_op.end());
+    double median = ns_per_op[ns_per_op.size() / 2];
+
+    cout << "  " << left << setw(48) << name << right << fixed << setprecision(1)
+         << setw(10) << median << setw(10) << ns_per_op.front()
+         << setw(14) << setprecision(0) << (median > 0 ? 1e9 / median : 0.0) << endl;
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+// Time each coherence hot path in isolation. Every iteration first puts the
+// caches back into the starting state directly (a few stores), then performs
+// exactly one operation through the normal code path.
+void runMicrobenchmarks(Bus& bus, const BenchmarkConfig& config) {
+    const int A = 0x40;                        // Address under test
+    const int B = A + CACHE_SIZE * 4;          // Maps to the same cache index as A
+    const int index = (A / 4) % CACHE_SIZE;
+    Processor& cpu0 = bus.processors[0];
+
+    cout << "\n=== MICROBENCHMARKS ===\n";
+#ifndef MOESI_NO_LOG
+    cout << "Note: built without -DMOESI_NO_LOG; logging is disabled at runtime but its checks remain\n";
+#endif
+    cout << "Iterations: " << config.iterations << " x " << config.repetitions << " repetitions\n";
+    cout << "  " << left << setw(48) << "Path" << right << setw(10) << "ns/op" << setw(10) << "best"
+         << setw(14) << "ops/s" << endl;
+
+    runBenchmark("Read hit", config, [&]() {
+        cpu0.cpu_operation(CpuOp::Read, A);
+    });
+    runBenchmark("Read miss, filled from memory", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Invalid);
+        cpu0.cpu_operation(CpuOp::Read, A);
+    });
+    runBenchmark("Read miss, cache-to-cache from M", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Invalid);
+        placeLine(bus, 1, A, 1, State::Modified);
+        cpu0.cpu_operation(CpuOp::Read, A);
+    });
+    runBenchmark("Read miss, cache-to-cache from O", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Invalid);
+        placeLine(bus, 1, A, 1, State::Owned);
+        cpu0.cpu_operation(CpuOp::Read, A);
+    });
+    runBenchmark("Write hit in E", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Exclusive);
+        cpu0.cpu_operation(CpuOp::Write, A, 1);
+    });
+    runBenchmark("Write hit in M", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Modified);
+        cpu0.cpu_operation(CpuOp::Write, A, 1);
+    });
+    runBenchmark("Write hit in S (BusUpgr)", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Shared);
+        placeLine(bus, 1, A, 0, State::Shared);
+        cpu0.cpu_operation(CpuOp::Write, A, 1);
+    });
+    runBenchmark("Write hit in O (BusUpgr)", config, [&]() {
+        placeLine(bus, 0, A, 0, State::Owned);
+        placeLine(bus, 1, A, 0, State::Shared);
+        cpu0.cpu_operation(CpuOp::Write, A, 1);
+    });
+    runBenchmark("Dirty conflict eviction (handleCacheEviction)", config, [&]() {
+        placeLine(bus, 0, A, 1, State::Modified);
+        cpu0.handleCacheEviction(B, index);
+    });
+
+    const CpuOp atomics[] = {
+        CpuOp::Atomic_CAS, CpuOp::Atomic_ADD, CpuOp::Atomic_SUB, CpuOp::Atomic_AND, CpuOp::Atomic_OR,
+        CpuOp::Atomic_XOR, CpuOp::Atomic_NAND, CpuOp::Atomic_NOR, CpuOp::Atomic_XNOR,
+    };
+    placeLine(bus, 0, A, 0, State::Modified);
+    for (CpuOp op : atomics) {
+        runBenchmark(cpuOpToString(op) + " (performAtomicOperation)", config, [&]() {
+            cpu0.performAtomicOperation(op, 1, index, 0);
+        });
+    }
+}
+
+// ============================================
+// SYNCHRONIZATION BENCHMARKS
+// ============================================
+
+// Classic synchronization algorithms written as per-core state machines. Every
+// step() issues exactly one cpu_operation, and the scheduler steps the unfinished
+// cores in round-robin order, so each run is deterministic. There is no swap
+// instruction, so test-and-set uses Atomic_OR and queue locks enqueue with a CAS loop.
+// Shared words live in the first words of memory; queue nodes and counter shards
+// start at SYNC_NODES, one node per core, each field in its own line.
+const int SYNC_LOCK = 0x0;       // Lock word, ticket dispenser, queue tail, barrier count or counter
+const int SYNC_SERVING = 0x4;    // Ticket lock now-serving, barrier sense
+const int SYNC_DATA = 0x8;       // Word protected by the lock
+const int SYNC_NODES = 0x40;
+
+int syncNode(int node, int field) { return SYNC_NODES + (2 * node + field) * 4; }
+
+struct SyncConfig {
+    int cores;
+    unsigned long long iterations;  // Acquires, barrier arrivals or increments per core
+    int critical_section;           // Read+Write pairs on SYNC_DATA while holding a lock
+
+    SyncConfig() : cores(NUM_PROCESSORS), iterations(1000), critical_section(1) {}
+};
+
+// Host-side bookkeeping that checks each algorithm actually synchronizes
+struct SyncCheck {
+    int holder;                     // Core inside the critical section, or -1
+    unsigned long long violations;
+    vector<unsigned long long> arrived;   // Barrier episodes each core has entered
+
+    explicit SyncCheck(int cores) : holder(-1), violations(0), arrived(cores, 0) {}
+};
+
+class SyncThread {
+protected:
+    Processor& cpu;
+    int core;
+    SyncCheck& check;
+
+    CpuResult op(CpuOp operation, int address, word_t value = 0, word_t expected = 0) {
+        ops++;
+        return cpu.cpu_operation(operation, address, value, expected);
+    }
+
+public:
+    unsigned long long ops;
+    unsigned long long completed;   // Acquires, barrier arrivals or increments
+
+    SyncThread(Processor& cpu, int core, SyncCheck& check) : cpu(cpu), core(core), check(check), ops(0), completed(0) {}
+    virtual ~SyncThread() {}
+
+    // Issue one operation
+    virtual void step() = 0;
+};
+
+// Acquire, critical section, release, repeated. Subclasses supply the lock.
+class LockThread : public SyncThread {
+private:
+    enum Phase { Acquiring, Critical, Releasing };
+    Phase phase;
+    int critical_ops;
+    int critical_left;
+    word_t data;
+
+protected:
+    virtual bool acquireStep() = 0;   // True once the lock is held
+    virtual bool releaseStep() = 0;   // True once the lock is released
+
+public:
+    LockThread(Processor& cpu, int core, SyncCheck& check, int critical_section)
+        : SyncThread(cpu, core, check), phase(Acquiring), critical_ops(2 * critical_section), critical_left(0), data(0) {}
+
+    void step() {
+        switch (phase) {
+            case Acquiring:
+                if (acquireStep()) {
+                    if (check.holder != -1) check.violations++;
+                    check.holder = core;
+                    phase = Critical;
+                    critical_left = critical_ops;
                 }
                 break;
-            case BusOp::BusRdX: // Read-for-Ownership request from initiator (P_i)
-                // Send data back to requester when snooped line is in M or O state
-                // Invalidate for all other states
-                
-                if (other_cache_line.state == State::Modified && address_match) {
-                    // Modified: Send data back, invalidate this cache line
-                    found_modified = true;
-                    response.data = other_cache_line.value;
-                    response.data_from_memory = false;
-                    response.state_changed = true;
-                    response.requester_new_state = State::Modified;
-                    response.present_state = State::Modified;
-                    response.core_id = i;
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Modified) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Modified) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
-                }
-                else if (other_cache_line.state == State::Owned && address_match) {
-                    // Owned: Send data back, invalidate this cache line
-                    found_owned = true;
-                    if (!found_modified) {
-                        response.data = other_cache_line.value;
-                        response.data_from_memory = false;
-                        response.state_changed = true;
-                        response.requester_new_state = State::Modified;
-                        response.present_state = State::Owned;
-                        response.core_id = i;
-                    }
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Owned) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Owned) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+            case Critical:
+                // Increment the protected word: Read, then Write the value plus one
+                if (critical_left % 2 == 0) {
+                    data = op(CpuOp::Read, SYNC_DATA).value;
+                } else {
+                    op(CpuOp::Write, SYNC_DATA, data + 1);
                 }
-                else if (other_cache_line.state == State::Exclusive && address_match) {
-                    // Exclusive: Forward data and invalidate this cache line
-                    found_exclusive = true;
-                    if (!found_modified && !found_owned) {
-                    response.data = other_cache_line.value;
-                    response.data_from_memory = false;
-                        response.state_changed = true;
-                        response.requester_new_state = State::Modified;
-                        response.present_state = State::Exclusive;
-                        response.core_id = i;
-                    }
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Exclusive) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Exclusive) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+                if (--critical_left == 0) {
+                    check.holder = -1;
+                    phase = Releasing;
                 }
-                else if (other_cache_line.state == State::Shared && address_match) {
-                    // Shared: Invalidate this cache line
-                    found_sharer = true;
-                    if (!found_modified && !found_owned && !found_exclusive) {
-                        response.data = memory[address];
-                        response.data_from_memory = true;
-                        response.state_changed = true;
-                        response.requester_new_state = State::Modified;
-                        response.present_state = State::Shared;
-                        response.core_id = i;
-                    }
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Shared) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Shared) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+                break;
+            case Releasing:
+                if (releaseStep()) {
+                    completed++;
+                    phase = Acquiring;
                 }
-                // Invalid: No action needed
                 break;
-            case BusOp::BusUpgr: // Upgrade request from initiator (P_i)
-                // BusUpgr: Invalidate all other copies, no data transfer needed
-                
-                if (other_cache_line.state == State::Modified && address_match) {
-                    // Modified: Should not happen with BusUpgr (requester already has Shared)
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Modified) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Modified) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+        }
+    }
+};
+
+// Test-and-set: every attempt is an atomic, so waiters keep stealing the line
+class TasLock : public LockThread {
+protected:
+    bool acquireStep() { return op(CpuOp::Atomic_OR, SYNC_LOCK, 1).value == 0; }
+    bool releaseStep() { op(CpuOp::Write, SYNC_LOCK, 0); return true; }
+
+public:
+    TasLock(Processor& cpu, int core, SyncCheck& check, int cs) : LockThread(cpu, core, check, cs) {}
+};
+
+// Test-and-test-and-set: spin on a cached copy, only try the atomic once the lock looks free
+class TtasLock : public LockThread {
+private:
+    bool looks_free;
+
+protected:
+    bool acquireStep() {
+        if (!looks_free) {
+            looks_free = op(CpuOp::Read, SYNC_LOCK).value == 0;
+            return false;
+        }
+        looks_free = false;
+        return op(CpuOp::Atomic_OR, SYNC_LOCK, 1).value == 0;
+    }
+    bool releaseStep() { op(CpuOp::Write, SYNC_LOCK, 0); return true; }
+
+public:
+    TtasLock(Processor& cpu, int core, SyncCheck& check, int cs) : LockThread(cpu, core, check, cs), looks_free(false) {}
+};
+
+// Ticket lock: one fetch-and-add for a ticket, then spin until now-serving reaches it
+class TicketLock : public LockThread {
+private:
+    bool has_ticket;
+    word_t ticket;
+
+protected:
+    bool acquireStep() {
+        if (!has_ticket) {
+            ticket = op(CpuOp::Atomic_ADD, SYNC_LOCK, 1).value;
+            has_ticket = true;
+            return false;
+        }
+        if (op(CpuOp::Read, SYNC_SERVING).value != ticket) return false;
+        has_ticket = false;
+        return true;
+    }
+    bool releaseStep() { op(CpuOp::Write, SYNC_SERVING, ticket + 1); return true; }
+
+public:
+    TicketLock(Processor& cpu, int core, SyncCheck& check, int cs) : LockThread(cpu, core, check, cs), has_ticket(false), ticket(0) {}
+};
+
+// MCS queue lock. Each core spins on its own node; the tail holds core + 1, 0 when free.
+// Node fields: 0 = locked flag, 1 = next (core + 1, 0 for none).
+class McsLock : public LockThread {
+private:
+    int acquire_state;
+    int release_state;
+    word_t seen;        // Tail value read before the CAS
+    word_t neighbour;   // Predecessor while acquiring, successor while releasing
+    word_t self() const { return core + 1; }
+
+protected:
+    bool acquireStep() {
+        switch (acquire_state) {
+            case 0: op(CpuOp::Write, syncNode(core, 1), 0); acquire_state = 1; return false;
+            case 1: op(CpuOp::Write, syncNode(core, 0), 1); acquire_state = 2; return false;
+            case 2: seen = op(CpuOp::Read, SYNC_LOCK).value; acquire_state = 3; return false;
+            case 3:
+                if (!op(CpuOp::Atomic_CAS, SYNC_LOCK, self(), seen).success) {
+                    acquire_state = 2;
+                    return false;
                 }
-                else if (other_cache_line.state == State::Owned && address_match) {
-                    // Owned: Invalidate this cache line
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Owned) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Owned) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+                neighbour = seen;
+                if (neighbour == 0) {
+                    acquire_state = 0;
+                    return true;
                 }
-                else if (other_cache_line.state == State::Exclusive && address_match) {
-                    // Exclusive: Invalidate this cache line
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Exclusive) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Exclusive) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+                acquire_state = 4;
+                return false;
+            case 4: op(CpuOp::Write, syncNode(static_cast<int>(neighbour) - 1, 1), self()); acquire_state = 5; return false;
+            default:
+                if (op(CpuOp::Read, syncNode(core, 0)).value != 0) return false;
+                acquire_state = 0;
+                return true;
+        }
+    }
+
+    bool releaseStep() {
+        switch (release_state) {
+            case 0:
+                neighbour = op(CpuOp::Read, syncNode(core, 1)).value;
+                release_state = neighbour ? 3 : 1;
+                return false;
+            case 1:
+                if (op(CpuOp::Atomic_CAS, SYNC_LOCK, 0, self()).success) {
+                    release_state = 0;
+                    return true;
                 }
-                else if (other_cache_line.state == State::Shared && address_match) {
-                    // Shared: Invalidate this cache line
-                    cout << "CPU - " << i << ": Snooped Cache-HIT @ addr 0x" << hex << address << dec << " (index " << cache_index << ") | state: " << stateToString(State::Shared) << endl;
-                    cout << "CPU - " << i << ": Snooped Cache-Line Transition | [" << stateToString(State::Shared) 
-                         << "->" << stateToString(State::Invalid) << "]" << endl;
-                    other_cache_line.state = State::Invalid;
+                release_state = 2;
+                return false;
+            case 2:
+                // A successor swapped itself in but has not linked yet
+                neighbour = op(CpuOp::Read, syncNode(core, 1)).value;
+                if (neighbour) release_state = 3;
+                return false;
+            default:
+                op(CpuOp::Write, syncNode(static_cast<int>(neighbour) - 1, 0), 0);
+                release_state = 0;
+                return true;
+        }
+    }
+
+public:
+    McsLock(Processor& cpu, int core, SyncCheck& check, int cs)
+        : LockThread(cpu, core, check, cs), acquire_state(0), release_state(0), seen(0), neighbour(0) {}
+};
+
+// CLH queue lock. Each core spins on its predecessor's node and takes that node
+// over on release. Nodes 0..cores-1 start with the cores, node `cores` is the
+// initial free node that the tail (node + 1) points at.
+class ClhLock : public LockThread {
+private:
+    int state;
+    int node;
+    int predecessor;
+    word_t seen;
+
+protected:
+    bool acquireStep() {
+        switch (state) {
+            case 0: op(CpuOp::Write, syncNode(node, 0), 1); state = 1; return false;
+            case 1: seen = op(CpuOp::Read, SYNC_LOCK).value; state = 2; return false;
+            case 2:
+                if (!op(CpuOp::Atomic_CAS, SYNC_LOCK, node + 1, seen).success) {
+                    state = 1;
+                    return false;
                 }
-                // Invalid: No action needed
+                predecessor = static_cast<int>(seen) - 1;
+                state = 3;
+                return false;
+            default:
+                if (op(CpuOp::Read, syncNode(predecessor, 0)).value != 0) return false;
+                state = 0;
+                return true;
+        }
+    }
+
+    bool releaseStep() {
+        op(CpuOp::Write, syncNode(node, 0), 0);
+        node = predecessor;
+        return true;
+    }
+
+public:
+    ClhLock(Processor& cpu, int core, SyncCheck& check, int cs)
+        : LockThread(cpu, core, check, cs), state(0), node(core), predecessor(-1), seen(0) {}
+};
+
+// Sense-reversing centralized barrier: fetch-and-add the count; the last arrival
+// resets it and flips the global sense, everyone else spins until the sense flips
+class BarrierThread : public SyncThread {
+private:
+    int cores;
+    int state;
+    word_t local_sense;
+
+    void finishEpisode() {
+        completed++;
+        // Nobody may leave episode k before every core has entered it
+        for (unsigned long long arrived : check.arrived) {
+            if (arrived < completed) check.violations++;
+        }
+        state = 0;
+    }
+
+public:
+    BarrierThread(Processor& cpu, int core, SyncCheck& check, int cores)
+        : SyncThread(cpu, core, check), cores(cores), state(0), local_sense(0) {}
+
+    void step() {
+        switch (state) {
+            case 0:
+                local_sense ^= 1;
+                check.arrived[core]++;
+                state = (op(CpuOp::Atomic_ADD, SYNC_LOCK, 1).value == cores - 1) ? 1 : 3;
                 break;
-            case BusOp::None:
-                
+            case 1: op(CpuOp::Write, SYNC_LOCK, 0); state = 2; break;
+            case 2: op(CpuOp::Write, SYNC_SERVING, local_sense); finishEpisode(); break;
+            default:
+                if (op(CpuOp::Read, SYNC_SERVING).value == local_sense) finishEpisode();
                 break;
-            }
+        }
+    }
+};
 
-        }   // End of for loop.
-        
-        // Set the final requester_new_state for the initiator based on snoop results
-        if (op == BusOp::BusRd) {
-            // BusRd: Read request
-            if (response.data_from_memory && !found_sharer && !found_exclusive && !found_modified && !found_owned) {
-                // No sharers found, data from memory -> Exclusive state
-                response.requester_new_state = State::Exclusive;
-            } else if (found_sharer || found_exclusive || found_modified || found_owned) {
-                // Data from cache or sharers exist -> Shared state
-                // Note: In MOESI, Shared state may be dirty if there's an Owned copy
-                // Priority handling (Modified/Owned) ensures correct data source
-                response.requester_new_state = State::Shared;
-            }
-        } else if (op == BusOp::BusRdX) {
-            // BusRdX: Read-for-Ownership request
-            if (found_modified || found_owned) {
-                // Data from Modified/Owned cache -> Modified state
-                response.requester_new_state = State::Modified;
-            } else {
-                // No data from cache, data from memory -> Modified state
-                response.requester_new_state = State::Modified;
-                response.data = memory[address];
-                response.data_from_memory = true;
-                response.core_id = -1;
+// Counter increments, either all on one shared word or each core on its own shard
+class CounterThread : public SyncThread {
+private:
+    int address;
+
+public:
+    CounterThread(Processor& cpu, int core, SyncCheck& check, bool sharded)
+        : SyncThread(cpu, core, check), address(sharded ? syncNode(core, 0) : SYNC_LOCK) {}
+
+    void step() {
+        op(CpuOp::Atomic_ADD, address, 1);
+        completed++;
+    }
+};
+
+// Run one workload from a clean machine and print its row. make(cpu, core, check)
+// builds each core's state machine; finish(bus, threads) runs any closing
+// operations and returns false if the final memory state is wrong.
+template <typename Make, typename Finish>
+void runSyncWorkload(Bus& bus, const SyncConfig& config, const string& name, const string& unit,
+                     Make make, Finish finish) {
+    bus.reset();
+    atomic_policy.forgetHistory();
+    SyncCheck check(config.cores);
+    vector<unique_ptr<SyncThread> > threads;
+    for (int i = 0; i < config.cores; i++) {
+        threads.push_back(unique_ptr<SyncThread>(make(bus.processors[i], i, check)));
+    }
+
+    bool running = true;
+    while (running) {
+        running = false;
+        for (int i = 0; i < config.cores; i++) {
+            if (threads[i]->completed < config.iterations) {
+                threads[i]->step();
+                running = true;
             }
         }
-        
-        return response;
     }
-};
+    bool correct = finish(bus, threads) && check.violations == 0;
 
-// Implementation of Processor::send_bus_operation
-BusResponse Processor::send_bus_operation(const BusOp& op, const int& address, const int& initiator_id) {
-    // Note: Lock is already held by calling cpu_operation()
-    return bus->broadcastBusOperation(op, address, initiator_id);
+    CoreStats total = bus.totalStats();
+    unsigned long long ops = 0;
+    unsigned long long units = 0;
+    for (int i = 0; i < config.cores; i++) {
+        ops += threads[i]->ops;
+        units += threads[i]->completed;
+    }
+    unsigned long long transactions = 0;
+    for (int op = 0; op < NUM_BUS_OPS; op++) transactions += total.bus_issued[op];
+    unsigned long long invalidations = 0;   // Remote copies removed by BusRdX/BusUpgr/BusAtomic
+    for (int copies = 0; copies < MAX_CORES; copies++) invalidations += copies * total.invalidation_fanout.buckets[copies];
+    // Cycles are per core: the summed core cycle counts over the summed units give the
+    // cycles one core spends per unit. The bus is not a shared resource in the timing
+    // model, so dividing the elapsed (slowest core's) cycles by every core's units
+    // would understate that cost by about the core count.
+
+    cout << "  " << left << setw(22) << name << setw(11) << unit << right << setw(12) << units
+         << fixed << setprecision(2) << setw(12) << static_cast<double>(ops) / units
+         << setw(12) << static_cast<double>(transactions) / units
+         << setw(14) << static_cast<double>(invalidations) / units
+         << setw(14) << static_cast<double>(total.cycles) / units
+         << "  " << (correct ? "OK" : "FAILED") << endl;
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
 }
 
-// Function to generate a random address within the memory bounds
-int addr_gen (array<int, MEMORY_SIZE>& mem) {
-    random_device rd;  // obtain a random number from hardware
-    mt19937 eng(rd()); // seed the generator
-    uniform_int_distribution<> distr(0, mem.size() - 1); // define the range
+// Every lock design, the barrier, and single vs sharded counters, each reporting
+// bus transactions and a core's simulated cycles per acquire, arrival or increment
+bool runSyncBenchmarks(Bus& bus, const SyncConfig& config) {
+    cout << dec << "\n=== SYNCHRONIZATION BENCHMARKS ===\n";
+    cout << "Cores: " << config.cores << " | " << config.iterations << " per core | critical section: "
+         << config.critical_section << " read+write | atomics: " << atomicPolicyToString(atomic_policy.policy) << endl;
+    cout << "  " << left << setw(22) << "Workload" << setw(11) << "Unit" << right << setw(12) << "Units"
+         << setw(12) << "Ops/unit" << setw(12) << "Bus/unit" << setw(14) << "Inval/unit"
+         << setw(14) << "Cycles/unit" << "  Check" << endl;
+
+    bool ok = true;
+    int cs = config.critical_section;
+    unsigned long long total_units = config.iterations * config.cores;
+    auto lock_correct = [&](Bus& b, vector<unique_ptr<SyncThread> >&) {
+        // The protected word must hold one increment per critical-section pass
+        bool correct = b.coherentValue(SYNC_DATA) == static_cast<word_t>(total_units * cs);
+        ok = ok && correct;
+        return correct;
+    };
+
+    runSyncWorkload(bus, config, "TAS lock", "acquire",
+                    [&](Processor& p, int i, SyncCheck& c) { return new TasLock(p, i, c, cs); }, lock_correct);
+    runSyncWorkload(bus, config, "TTAS lock", "acquire",
+                    [&](Processor& p, int i, SyncCheck& c) { return new TtasLock(p, i, c, cs); }, lock_correct);
+    runSyncWorkload(bus, config, "Ticket lock", "acquire",
+                    [&](Processor& p, int i, SyncCheck& c) { return new TicketLock(p, i, c, cs); }, lock_correct);
+    runSyncWorkload(bus, config, "MCS lock", "acquire",
+                    [&](Processor& p, int i, SyncCheck& c) { return new McsLock(p, i, c, cs); }, lock_correct);
+    runSyncWorkload(bus, config, "CLH lock", "acquire",
+                    [&](Processor& p, int i, SyncCheck& c) {
+                        memory[SYNC_LOCK] = config.cores + 1;   // Tail starts at the free node
+                        return new ClhLock(p, i, c, cs);
+                    }, lock_correct);
+    runSyncWorkload(bus, config, "Sense barrier", "arrival",
+                    [&](Processor& p, int i, SyncCheck& c) { return new BarrierThread(p, i, c, config.cores); },
+                    [&](Bus&, vector<unique_ptr<SyncThread> >&) { return true; });
 
-    int random_index = (distr(eng) * 4) / 4;
-    return random_index;
+    for (int sharded = 0; sharded < 2; sharded++) {
+        runSyncWorkload(bus, config, sharded ? "Sharded counter" : "Single counter", "increment",
+                        [&](Processor& p, int i, SyncCheck& c) { return new CounterThread(p, i, c, sharded != 0); },
+                        [&](Bus& b, vector<unique_ptr<SyncThread> >& threads) {
+                            // Reading the total is part of the cost: one word, or every shard
+                            word_t sum = 0;
+                            int words = sharded ? config.cores : 1;
+                            for (int i = 0; i < words; i++) {
+                                sum += b.processors[0].cpu_operation(CpuOp::Read, sharded ? syncNode(i, 0) : SYNC_LOCK).value;
+                                threads[0]->ops++;
+                            }
+                            bool correct = sum == static_cast<word_t>(total_units);
+                            ok = ok && correct;
+                            return correct;
+                        });
+    }
+    return ok;
 }
 
 // ============================================
@@ -798,7 +3159,7 @@ void runReadWriteTest(Bus& bus) {
 // Atomic operations test: 4 threads incrementing a shared counter
 void runAtomicADDTest(Bus& bus) {
     const int SHARED_COUNTER_ADDR = 1000;
-    const int EXPECTED_FINAL_VALUE = 4;
+    const int EXPECTED_FINAL_VALUE = NUM_PROCESSORS;
     
     // Initialize shared counter to 0
     memory[SHARED_COUNTER_ADDR] = 0;
@@ -807,9 +3168,10 @@ void runAtomicADDTest(Bus& bus) {
     cout << "=== 4 threads (simulating 4 CPU cores) incrementing shared counter from 0 to 4 ===\n\n";
     cout << "Initial value: " << memory[SHARED_COUNTER_ADDR] << endl << endl;
     
-    // Lambda function for thread to perform atomic increment
+    // Lambda function for thread to perform atomic increment, keeping the value it fetched
+    word_t fetched[NUM_PROCESSORS];
     auto incrementCounter = [&](int core_id) {
-        bus.processors[core_id].cpu_operation(CpuOp::Atomic_ADD, SHARED_COUNTER_ADDR, 1);
+        fetched[core_id] = bus.processors[core_id].cpu_operation(CpuOp::Atomic_ADD, SHARED_COUNTER_ADDR, 1).value;
     };
     
     // Create 4 threads, each running on a different core
@@ -841,8 +3203,18 @@ void runAtomicADDTest(Bus& bus) {
     cout << "\n=== FINAL RESULT ===\n";
     cout << "Expected final value: " << EXPECTED_FINAL_VALUE << endl;
     
+    // Fetch-and-add hands every thread a distinct old value, 0 to N-1
+    sort(fetched, fetched + NUM_PROCESSORS);
+    bool fetched_distinct = true;
+    cout << "Old values fetched by the threads (sorted):";
+    for (int i = 0; i < NUM_PROCESSORS; i++) {
+        cout << " " << fetched[i];
+        fetched_distinct = fetched_distinct && fetched[i] == i;
+    }
+    cout << endl;
+
     // Find the cache line in Modified state and check its value
-    int final_value = 0;
+    word_t final_value = 0;
     bool found_modified = false;
     for (int i = 0; i < NUM_PROCESSORS; i++) {
         int index = (SHARED_COUNTER_ADDR / 4) % CACHE_SIZE;
@@ -859,23 +3231,371 @@ void runAtomicADDTest(Bus& bus) {
         cout << "ERROR: No cache line in Modified state found!" << endl;
     }
     
-    cout << "\nAtomic ADD: Test " << (found_modified && final_value == EXPECTED_FINAL_VALUE ? "PASSED" : "FAILED") << endl;
+    cout << "\nAtomic ADD: Test " << (found_modified && final_value == EXPECTED_FINAL_VALUE && fetched_distinct ? "PASSED" : "FAILED") << endl;
+}
+
+// Bulk operations whose ranges leave memory. Each runs as a trace record on a
+// scratch bus and must cover only the words that lie in memory. Global memory is
+// restored afterwards, so the statistics of the tests above are unaffected.
+void runBulkBoundsTest() {
+    struct BoundsCase {
+        TraceRecord record;
+        unsigned long long words;
+    };
+    const BoundsCase cases[] = {
+        {{0, CpuOp::Mem_Copy, 0x100, 10000, 64}, 0},                       // Source past the end of memory
+        {{0, CpuOp::Mem_Copy, 0x100, static_cast<word_t>(-4), 64}, 0},     // Negative source
+        {{0, CpuOp::Mem_Copy, 0x100, MEMORY_SIZE - 8, 64}, 2},             // Source range clipped
+        {{0, CpuOp::Mem_Set, MEMORY_SIZE - 4, 7, 64}, 1},                  // Destination range clipped
+    };
+
+    cout << "\n=== BULK BOUNDS TEST ===\n";
+    array<word_t, MEMORY_SIZE> saved_memory = memory;
+    array<unsigned long long, MEMORY_SIZE> saved_stores = word_stores;
+    bool saved_log = log_enabled;
+    log_enabled = false;
+
+    Bus scratch;
+    bool passed = true;
+    for (const BoundsCase& test : cases) {
+        scratch.reset();
+        executeTraceRecord(scratch, test.record);
+        unsigned long long words = scratch.totalStats().bulk_words;
+        cout << cpuOpToString(test.record.op) << " @ addr 0x" << hex << test.record.address;
+        if (test.record.op == CpuOp::Mem_Copy) {
+            cout << " from 0x" << static_cast<int>(test.record.value);
+        }
+        cout << dec << " | " << test.record.expected << " bytes | words covered: " << words << " (expected " << test.words << ")" << endl;
+        passed = passed && words == test.words;
+    }
+
+    memory = saved_memory;
+    word_stores = saved_stores;
+    log_enabled = saved_log;
+    cout << "\nBulk bounds: Test " << (passed ? "PASSED" : "FAILED") << endl;
 }
 
 // ============================================
 // MAIN
 // ============================================
 
-int main() {
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  (no mode option)    run the built-in coherence tests\n"
+         << "  --replay FILE       replay a trace file in detail\n"
+         << "  --bench             time the coherence hot paths (build with -O2 -DMOESI_NO_LOG)\n"
+         << "  --bench-iterations N    timed operations per repetition (default 200000)\n"
+         << "  --bench-repetitions N   repetitions per benchmark (default 5)\n"
+         << "  --sample FILE       replay a trace with systematic sampling\n"
+         << "  --period N          accesses per sampling unit (default 100000)\n"
+         << "  --window N          measured accesses per sampling unit (default 1000)\n"
+         << "  --workload PATTERN  run a synthetic workload: uniform, zipfian, strided, hotspot,\n"
+         << "                      producer-consumer, migratory, read-mostly\n"
+         << "  --ops N             accesses per core (default 100000)\n"
+         << "  --mix R,W,A         read/write/atomic weights (default 0.7,0.25,0.05)\n"
+         << "  --atomic-op OP      atomic operation used by the mix (default Atomic_ADD)\n"
+         << "  --store-op OP       store used by the workload: Write (default) or Store_NT\n"
+         << "  --bulk-nt           Mem_Copy/Mem_Set/Mem_Zero write their destination with Store_NT\n"
+         << "  --footprint N       words touched by the workload (default all of memory)\n"
+         << "  --zipf-theta X      Zipfian skew (default 0.99)\n"
+         << "  --seed N            workload seed (default 1)\n"
+         << "  --stress            drive each core from its own host thread with the workload\n"
+         << "  --threads N         cores used by --stress and --sync (default NUM_PROCESSORS)\n"
+         << "  --write-trace FILE  write the workload as a trace instead of running it\n"
+         << "  --atomic-policy P   where atomics execute: near (default), far or adaptive\n"
+         << "  --far-threshold N   adaptive: core changes per address before going far (default 4)\n"
+         << "  --far-address ADDR  always execute atomics to ADDR at memory (repeatable)\n"
+         << "  --near-address ADDR always execute atomics to ADDR in the cache (repeatable)\n"
+         << "  --victim-buffer N   fully-associative victim buffer of N L1 conflict victims per core\n"
+         << "  --wb-buffer N       write-back buffer of N dirty victims per core, drained in the background\n"
+         << "  --l2 P              private L2 per core: none (default), inclusive or exclusive\n"
+         << "  --l2-sets N         L2 sets (default 64)\n"
+         << "  --l2-ways N         L2 associativity (default 4)\n"
+         << "  --llc P             shared last-level cache: none (default), inclusive, non-inclusive\n"
+         << "                      or exclusive\n"
+         << "  --llc-sets N        LLC sets (default 32)\n"
+         << "  --llc-ways N        LLC associativity (default 8)\n"
+         << "  --prefetch K        hardware prefetcher per core: none (default), next-line, stride\n"
+         << "                      or stream\n"
+         << "  --prefetch-degree N lines fetched per prefetcher trigger (default 2)\n"
+         << "  --rfo-predict       learn read-then-store addresses and read them with BusRdX\n"
+         << "  --write-update      stores to shared lines update the other copies (BusUpd) instead\n"
+         << "                      of invalidating them\n"
+         << "  --update-region A:B write-update for byte addresses A up to B only (repeatable)\n"
+         << "  --sync              run the synchronization benchmarks (locks, barrier, counters)\n"
+         << "  --sync-iterations N acquires, barrier arrivals or increments per core (default 1000)\n"
+         << "  --sync-critical N   read+write pairs inside each critical section (default 1)\n"
+         << "  --hot-lines K       profile the top-K most invalidated and migrated lines\n"
+         << "  --stats-json FILE   export counters as JSON\n"
+         << "  --stats-csv FILE    export counters as CSV\n"
+         << "  --stats-prom FILE   export counters in Prometheus textfile format\n"
+         << "  --stats-interval N  also export every N operations (default: end of run only)\n"
+         << "  --timeseries FILE   snapshot all counters periodically and dump them to FILE\n"
+         << "  --timeseries-interval N   operations between snapshots (default 10000)\n"
+         << "  --timeseries-cycles       measure the interval in simulated cycles instead\n"
+         << "  --timeseries-capacity N   snapshots kept in the ring buffer (default 4096)\n"
+         << "  --verbose           keep the per-access protocol log during replay\n";
+}
+
+int main(int argc, char* argv[]) {
     // Create the bus (automatically initializes all processors)
     Bus bus;
 
-    // Run the read-write test (test the basic read-write operations and cache coherence)
-    runReadWriteTest(bus);
-    
-    // Run the atomic add test (4 threads incrementing a shared counter from 0 to 4)
-    runAtomicADDTest(bus);
+    string replay_path;
+    string sample_path;
+    SamplingConfig sampling;
+    size_t hot_lines = 0;
+    bool bench = false;
+    BenchmarkConfig bench_config;
+    StatsExporter exporter;
+    string timeseries_path;
+    unsigned long long timeseries_interval = 10000;
+    size_t timeseries_capacity = 4096;
+    bool timeseries_cycles = false;
+    bool verbose = false;
+    string workload_name;
+    WorkloadConfig workload;
+    workload.num_cores = NUM_PROCESSORS;
+    workload.footprint_words = MEMORY_SIZE / 4;
+    unsigned long long workload_ops = 100000;
+    string workload_trace_path;
+    bool stress = false;
+    bool sync = false;
+    SyncConfig sync_config;
+    int stress_threads = NUM_PROCESSORS;
+    LLCPolicy llc_policy = LLCPolicy::None;
+    int llc_sets = 32;
+    int llc_ways = 8;
 
-    return 0;
-}
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--replay" && has_value) {
+            replay_path = argv[++i];
+        } else if (arg == "--sample" && has_value) {
+            sample_path = argv[++i];
+        } else if (arg == "--period" && has_value) {
+            sampling.period = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--window" && has_value) {
+            sampling.window = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--bench") {
+            bench = true;
+        } else if (arg == "--bench-iterations" && has_value) {
+            bench_config.iterations = max(1ULL, strtoull(argv[++i], nullptr, 0));
+        } else if (arg == "--bench-repetitions" && has_value) {
+            bench_config.repetitions = max(1, atoi(argv[++i]));
+        } else if (arg == "--workload" && has_value) {
+            workload_name = argv[++i];
+            if (!stringToPattern(workload_name, workload.pattern)) {
+                cerr << "ERROR: unknown workload '" << workload_name << "'" << endl;
+                return 1;
+            }
+        } else if (arg == "--ops" && has_value) {
+            workload_ops = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--mix" && has_value) {
+            if (!parseMix(argv[++i], workload)) {
+                cerr << "ERROR: --mix expects three non-negative weights R,W,A" << endl;
+                return 1;
+            }
+        } else if (arg == "--atomic-op" && has_value) {
+            string name = argv[++i];
+            if (!stringToCpuOp(name, workload.atomic_op) || !isAtomicOp(workload.atomic_op)) {
+                cerr << "ERROR: unknown atomic operation '" << name << "'" << endl;
+                return 1;
+            }
+        } else if (arg == "--store-op" && has_value) {
+            string name = argv[++i];
+            if (!stringToCpuOp(name, workload.store_op) || (workload.store_op != CpuOp::Write && workload.store_op != CpuOp::Store_NT)) {
+                cerr << "ERROR: --store-op expects Write or Store_NT" << endl;
+                return 1;
+            }
+        } else if (arg == "--footprint" && has_value) {
+            workload.footprint_words = min(max(1, atoi(argv[++i])), MEMORY_SIZE / 4);
+        } else if (arg == "--zipf-theta" && has_value) {
+            workload.zipf_theta = strtod(argv[++i], nullptr);
+            if (workload.zipf_theta <= 0 || workload.zipf_theta == 1.0) {
+                cerr << "ERROR: --zipf-theta must be positive and not 1" << endl;
+                return 1;
+            }
+        } else if (arg == "--seed" && has_value) {
+            workload.seed = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--sync") {
+            sync = true;
+        } else if (arg == "--sync-iterations" && has_value) {
+            sync_config.iterations = max(1ULL, strtoull(argv[++i], nullptr, 0));
+        } else if (arg == "--sync-critical" && has_value) {
+            sync_config.critical_section = max(1, atoi(argv[++i]));
+        } else if (arg == "--stress") {
+            stress = true;
+        } else if (arg == "--threads" && has_value) {
+            stress_threads = atoi(argv[++i]);
+            if (stress_threads < 1 || stress_threads > NUM_PROCESSORS) {
+                cerr << "ERROR: --threads must be between 1 and " << NUM_PROCESSORS << " (rebuild with -DNUM_PROCESSORS=N for more)" << endl;
+                return 1;
+            }
+        } else if (arg == "--write-trace" && has_value) {
+            workload_trace_path = argv[++i];
+        } else if (arg == "--atomic-policy" && has_value) {
+            string name = argv[++i];
+            if (!stringToAtomicPolicy(name, atomic_policy.policy)) {
+                cerr << "ERROR: unknown atomic policy '" << name << "'" << endl;
+                return 1;
+            }
+        } else if (arg == "--far-threshold" && has_value) {
+            atomic_policy.threshold = max(1, atoi(argv[++i]));
+        } else if ((arg == "--far-address" || arg == "--near-address") && has_value) {
+            long address = strtol(argv[++i], nullptr, 0);
+            if (address < 0 || address >= MEMORY_SIZE) {
+                cerr << "ERROR: " << arg << " outside memory" << endl;
+                return 1;
+            }
+            atomic_policy.pin(static_cast<int>(address), arg == "--far-address" ? AtomicPolicy::Far : AtomicPolicy::Near);
+        } else if (arg == "--victim-buffer" && has_value) {
+            victim_buffer_entries = max(0, atoi(argv[++i]));
+        } else if (arg == "--wb-buffer" && has_value) {
+            writeback_buffer_entries = max(0, atoi(argv[++i]));
+        } else if (arg == "--l2" && has_value) {
+            string name = argv[++i];
+            if (!stringToL2Policy(name, l2_config.policy)) {
+                cerr << "ERROR: unknown L2 policy '" << name << "'" << endl;
+                return 1;
+            }
+        } else if (arg == "--l2-sets" && has_value) {
+            l2_config.sets = max(1, atoi(argv[++i]));
+        } else if (arg == "--l2-ways" && has_value) {
+            l2_config.ways = max(1, atoi(argv[++i]));
+        } else if (arg == "--llc" && has_value) {
+            string name = argv[++i];
+            if (!stringToLLCPolicy(name, llc_policy)) {
+                cerr << "ERROR: unknown LLC policy '" << name << "'" << endl;
+                return 1;
+            }
+        } else if (arg == "--llc-sets" && has_value) {
+            llc_sets = max(1, atoi(argv[++i]));
+        } else if (arg == "--llc-ways" && has_value) {
+            llc_ways = max(1, atoi(argv[++i]));
+        } else if (arg == "--prefetch" && has_value) {
+            string name = argv[++i];
+            if (!stringToPrefetcher(name, prefetch_config.kind)) {
+                cerr << "ERROR: unknown prefetcher '" << name << "'" << endl;
+                return 1;
+            }
+        } else if (arg == "--prefetch-degree" && has_value) {
+            prefetch_config.degree = max(1, atoi(argv[++i]));
+        } else if (arg == "--write-update") {
+            write_update.fill(true);
+            write_update_enabled = true;
+        } else if (arg == "--update-region" && has_value) {
+            char* rest = nullptr;
+            long start = strtol(argv[++i], &rest, 0);
+            long end = (*rest == ':') ? strtol(rest + 1, nullptr, 0) : -1;
+            if (start < 0 || end <= start || end > MEMORY_SIZE) {
+                cerr << "ERROR: --update-region needs START:END inside memory" << endl;
+                return 1;
+            }
+            fill(write_update.begin() + start, write_update.begin() + end, true);
+            write_update_enabled = true;
+        } else if (arg == "--rfo-predict") {
+            ownership_prediction = true;
+        } else if (arg == "--bulk-nt") {
+            bulk_non_temporal = true;
+        } else if (arg == "--hot-lines" && has_value) {
+            hot_lines = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--stats-json" && has_value) {
+            exporter.json_path = argv[++i];
+        } else if (arg == "--stats-csv" && has_value) {
+            exporter.csv_path = argv[++i];
+        } else if (arg == "--stats-prom" && has_value) {
+            exporter.prometheus_path = argv[++i];
+        } else if (arg == "--stats-interval" && has_value) {
+            exporter.interval = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--timeseries" && has_value) {
+            timeseries_path = argv[++i];
+        } else if (arg == "--timeseries-interval" && has_value) {
+            timeseries_interval = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--timeseries-capacity" && has_value) {
+            timeseries_capacity = strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--timeseries-cycles") {
+            timeseries_cycles = true;
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    bus.llc.configure(llc_policy, llc_sets, llc_ways);
+    for (Processor& processor : bus.processors) {
+        processor.victims.configure(victim_buffer_entries);
+        processor.l2.configure(l2_config.policy, l2_config.sets, l2_config.ways);
+        processor.writebacks.configure(writeback_buffer_entries);
+        processor.prefetcher.kind = prefetch_config.kind;
+        processor.prefetcher.degree = prefetch_config.degree;
+        processor.ownership.enabled = ownership_prediction;
+    }
+
+    HotLineProfiler profiler(hot_lines);
+    if (hot_lines > 0) {
+        bus.profiler = &profiler;
+    }
+    if (exporter.enabled()) {
+        bus.exporter = &exporter;
+    }
+    TimeSeriesRecorder timeseries(NUM_PROCESSORS, timeseries_path.empty() ? 0 : timeseries_capacity,
+                                  timeseries_interval, timeseries_cycles);
+    if (!timeseries_path.empty()) {
+        bus.timeseries = &timeseries;
+    }
+
+    bool ok = true;
+    if (bench) {
+        log_enabled = false;
+        runMicrobenchmarks(bus, bench_config);
+    } else if (sync) {
+        log_enabled = verbose;
+        sync_config.cores = stress_threads;
+        ok = runSyncBenchmarks(bus, sync_config);
+    } else if (stress) {
+        log_enabled = false;
+        ok = runStress(bus, workload, stress_threads, workload_ops);
+    } else if (!workload_name.empty()) {
+        if (!workload_trace_path.empty()) {
+            ok = writeWorkloadTrace(workload_trace_path, workload, workload_ops);
+        } else {
+            log_enabled = verbose;
+            runWorkload(bus, workload, workload_ops);
+        }
+    } else if (!replay_path.empty() || !sample_path.empty()) {
+        log_enabled = verbose;
+        if (!replay_path.empty()) {
+            ok = runTraceReplay(bus, replay_path) && ok;
+        }
+        if (!sample_path.empty()) {
+            ok = runSampledSimulation(bus, sample_path, sampling) && ok;
+        }
+    } else {
+        // Run the read-write test (test the basic read-write operations and cache coherence)
+        runReadWriteTest(bus);
+
+        // Run the atomic add test (4 threads incrementing a shared counter from 0 to 4)
+        runAtomicADDTest(bus);
 
+        // Run the bulk bounds test (ranges that leave memory cover only the words inside it)
+        runBulkBoundsTest();
+
+        bus.printStats();
+    }
+
+    if (bus.profiler) {
+        bus.profiler->report();
+    }
+    if (bus.exporter) {
+        ok = bus.exportStats() && ok;
+    }
+    if (bus.timeseries) {
+        ok = bus.timeseries->dump(timeseries_path) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
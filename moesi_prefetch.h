@@ -0,0 +1,195 @@
+#ifndef MOESI_PREFETCH_H
+#define MOESI_PREFETCH_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+enum class PrefetcherKind {
+    None,
+    NextLine,   // On every miss, the next degree lines.
+    Stride,     // Per-region address-delta table (no PC): a delta seen twice in a row is prefetched ahead.
+    Stream,     // Tracks ascending or descending miss streams and runs degree lines ahead once confirmed.
+};
+
+string prefetcherToString(PrefetcherKind kind) {
+    switch (kind) {
+        case PrefetcherKind::None: return "none";
+        case PrefetcherKind::NextLine: return "next-line";
+        case PrefetcherKind::Stride: return "stride";
+        case PrefetcherKind::Stream: return "stream";
+        default: return "unknown";
+    }
+}
+
+bool stringToPrefetcher(const string& name, PrefetcherKind& kind) {
+    static const PrefetcherKind kinds[] = {
+        PrefetcherKind::None, PrefetcherKind::NextLine, PrefetcherKind::Stride, PrefetcherKind::Stream,
+    };
+    for (PrefetcherKind candidate : kinds) {
+        if (prefetcherToString(candidate) == name) {
+            kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Address predictor for one core. It sees that core's demand misses and proposes
+// addresses to fetch; the Processor filters them (bounds, already cached) and
+// issues them. Lines hold one 4-byte word, so the next line is address + 4.
+class Prefetcher {
+private:
+    static const int LINE_BYTES = 4;
+    static const int REGION_BYTES = 64;      // Stride table granularity
+    static const int STRIDE_ENTRIES = 16;
+    static const int STREAMS = 4;
+    static const int STREAM_WINDOW = 4;      // Lines ahead of a stream a miss may land and still extend it
+
+    struct StrideEntry {
+        int region;
+        int last_address;
+        int delta;
+        int confidence;
+    };
+
+    struct Stream {
+        int next_address;                    // Where the stream's next miss is expected
+        int direction;                       // +LINE_BYTES or -LINE_BYTES, 0 while unused
+        int confirmations;
+        unsigned long long last_use;
+    };
+
+    StrideEntry stride_table[STRIDE_ENTRIES];
+    Stream streams[STREAMS];
+    unsigned long long clock;
+
+    void nextLine(int address, vector<int>& out) const {
+        for (int k = 1; k <= degree; k++) out.push_back(address + k * LINE_BYTES);
+    }
+
+    void stride(int address, vector<int>& out) {
+        int region = address / REGION_BYTES;
+        StrideEntry& entry = stride_table[region % STRIDE_ENTRIES];
+        if (entry.region != region) {
+            entry.region = region;
+            entry.last_address = address;
+            entry.delta = 0;
+            entry.confidence = 0;
+            return;
+        }
+        int delta = address - entry.last_address;
+        entry.last_address = address;
+        if (delta == 0) return;
+        if (delta == entry.delta) {
+            if (entry.confidence < 3) entry.confidence++;
+        } else {
+            entry.delta = delta;
+            entry.confidence = 0;
+        }
+        if (entry.confidence >= 1) {
+            for (int k = 1; k <= degree; k++) out.push_back(address + k * delta);
+        }
+    }
+
+    void stream(int address, vector<int>& out) {
+        clock++;
+        for (Stream& s : streams) {
+            if (s.direction == 0) continue;
+            int ahead = (address - s.next_address) / s.direction;
+            if ((address - s.next_address) % s.direction != 0 || ahead < 0 || ahead >= STREAM_WINDOW) continue;
+            s.next_address = address + s.direction;
+            s.confirmations++;
+            s.last_use = clock;
+            if (s.confirmations >= 2) {
+                for (int k = 1; k <= degree; k++) out.push_back(address + k * s.direction);
+            }
+            return;
+        }
+
+        // No stream claims the miss: start an ascending one in the least recently used
+        // tracker, or a descending one if the miss sits just below a recent stream start
+        Stream* victim = &streams[0];
+        for (Stream& s : streams) {
+            if (s.last_use < victim->last_use) victim = &s;
+        }
+        int direction = LINE_BYTES;
+        for (const Stream& s : streams) {
+            if (s.direction != 0 && s.confirmations == 0 && address == s.next_address - 2 * s.direction) {
+                direction = -s.direction;
+            }
+        }
+        victim->next_address = address + direction;
+        victim->direction = direction;
+        victim->confirmations = 0;
+        victim->last_use = clock;
+    }
+
+public:
+    PrefetcherKind kind;
+    int degree;
+
+    Prefetcher() : clock(0), kind(PrefetcherKind::None), degree(2) {
+        reset();
+    }
+
+    void reset() {
+        for (StrideEntry& entry : stride_table) entry = StrideEntry{-1, 0, 0, 0};
+        for (Stream& s : streams) s = Stream{0, 0, 0, 0};
+        clock = 0;
+    }
+
+    bool enabled() const { return kind != PrefetcherKind::None; }
+
+    // Train on a demand miss and append the addresses to prefetch to out
+    void onMiss(int address, vector<int>& out) {
+        switch (kind) {
+            case PrefetcherKind::NextLine: nextLine(address, out); break;
+            case PrefetcherKind::Stride: stride(address, out); break;
+            case PrefetcherKind::Stream: stream(address, out); break;
+            default: break;
+        }
+    }
+};
+
+// Learns which addresses a core reads and then writes, so the read can fetch the
+// line with BusRdX and the store finds it already exclusive. Direct-mapped table of
+// 2-bit counters keyed by address; one read-then-store is enough to start predicting.
+class OwnershipPredictor {
+private:
+    static const int ENTRIES = 64;
+
+    struct Entry {
+        int address;
+        unsigned char counter;
+    };
+
+    Entry table[ENTRIES];
+
+    Entry& entryFor(int address) { return table[(address / 4) % ENTRIES]; }
+
+public:
+    bool enabled;
+
+    OwnershipPredictor() : enabled(false) {
+        for (Entry& entry : table) entry = Entry{-1, 0};
+    }
+
+    bool predict(int address) {
+        const Entry& entry = entryFor(address);
+        return entry.address == address && entry.counter >= 2;
+    }
+
+    // A read of address was followed by a store (stored) or by another read miss
+    void train(int address, bool stored) {
+        Entry& entry = entryFor(address);
+        if (entry.address != address) {
+            if (stored) entry = Entry{address, 2};
+            return;
+        }
+        if (stored && entry.counter < 3) entry.counter++;
+        if (!stored && entry.counter > 0) entry.counter--;
+    }
+};
+
+#endif // MOESI_PREFETCH_H
@@ -0,0 +1,147 @@
+#ifndef MOESI_PROFILER_H
+#define MOESI_PROFILER_H
+
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Space-Saving top-K counter (Metwally et al.) over int keys, in bounded memory.
+// Entries stay sorted by count, highest first. Every update adds exactly one, so
+// an entry only ever moves to the front of its own equal-count run before being
+// bumped: O(1) per update. A key that is not tracked replaces the minimum entry
+// and inherits its count, which is remembered as the entry's maximum overcount.
+class SpaceSaving {
+public:
+    struct Entry {
+        int key;
+        unsigned long long count;
+        unsigned long long error;   // Upper bound on how much count overestimates the true frequency
+        uint64_t cores;             // Bitmask of cores involved since the entry was (re)claimed
+    };
+
+private:
+    size_t capacity;
+    vector<Entry> entries;
+    unordered_map<int, size_t> slot_of;                   // key -> index in entries
+    unordered_map<unsigned long long, size_t> run_start;  // count -> first index holding that count
+
+    void swapSlots(size_t a, size_t b) {
+        if (a == b) return;
+        swap(entries[a], entries[b]);
+        slot_of[entries[a].key] = a;
+        slot_of[entries[b].key] = b;
+    }
+
+    // Add one to the entry at index i, keeping the array sorted. Returns its new index.
+    size_t bump(size_t i) {
+        unsigned long long count = entries[i].count;
+        size_t first = run_start[count];
+        swapSlots(i, first);
+        entries[first].count++;
+        if (first + 1 < entries.size() && entries[first + 1].count == count) {
+            run_start[count] = first + 1;
+        } else {
+            run_start.erase(count);
+        }
+        if (run_start.find(count + 1) == run_start.end()) {
+            run_start[count + 1] = first;
+        }
+        return first;
+    }
+
+public:
+    explicit SpaceSaving(size_t k) : capacity(k) {
+        entries.reserve(k);
+        slot_of.reserve(k);
+        run_start.reserve(k);
+    }
+
+    void increment(int key, uint64_t cores) {
+        if (capacity == 0) return;
+        size_t i;
+        unordered_map<int, size_t>::iterator it = slot_of.find(key);
+        if (it != slot_of.end()) {
+            i = it->second;
+        } else if (entries.size() < capacity) {
+            Entry entry = {key, 0, 0, 0};
+            entries.push_back(entry);
+            i = entries.size() - 1;
+            slot_of[key] = i;
+            if (run_start.find(0) == run_start.end()) run_start[0] = i;
+        } else {
+            // Evict the minimum, which is always the last entry
+            i = entries.size() - 1;
+            slot_of.erase(entries[i].key);
+            entries[i].key = key;
+            entries[i].error = entries[i].count;
+            entries[i].cores = 0;
+            slot_of[key] = i;
+        }
+        i = bump(i);
+        entries[i].cores |= cores;
+    }
+
+    // Tracked entries, highest count first
+    const vector<Entry>& top() const { return entries; }
+};
+
+// Finds the lines that ping-pong between cores. Tracks the top-K addresses by
+// invalidating transactions (BusRdX/BusUpgr that removed at least one remote
+// copy) and by ownership migrations (the line moved to the requester while
+// another core held it in M, O or E), with the cores seen on each.
+class HotLineProfiler {
+private:
+    SpaceSaving invalidations;
+    SpaceSaving migrations;
+
+    static string coreList(uint64_t cores) {
+        string list;
+        for (int i = 0; i < 64; i++) {
+            if (cores & (uint64_t(1) << i)) {
+                if (!list.empty()) list += ",";
+                list += to_string(i);
+            }
+        }
+        return list;
+    }
+
+    static void printTable(const string& title, const vector<SpaceSaving::Entry>& entries) {
+        cout << title << endl;
+        if (entries.empty()) {
+            cout << "  (none)" << endl;
+            return;
+        }
+        cout << "  " << left << setw(6) << "Rank" << setw(10) << "Address" << right << setw(14) << "Count"
+             << setw(14) << "Max error" << "  Cores" << endl;
+        for (size_t i = 0; i < entries.size(); i++) {
+            cout << "  " << left << setw(6) << (i + 1) << setw(10) << ("0x" + toHex(entries[i].key)) << right
+                 << setw(14) << entries[i].count << setw(14) << entries[i].error
+                 << "  " << coreList(entries[i].cores) << endl;
+        }
+    }
+
+    static string toHex(int value) {
+        ostringstream out;
+        out << hex << value;
+        return out.str();
+    }
+
+public:
+    explicit HotLineProfiler(size_t k) : invalidations(k), migrations(k) {}
+
+    void recordInvalidation(int address, uint64_t cores) { invalidations.increment(address, cores); }
+    void recordMigration(int address, uint64_t cores) { migrations.increment(address, cores); }
+
+    void report() const {
+        cout << dec << "\n=== HOT LINES ===\n";
+        printTable("Top lines by invalidating transactions:", invalidations.top());
+        printTable("Top lines by ownership migrations:", migrations.top());
+    }
+};
+
+#endif // MOESI_PROFILER_H
@@ -0,0 +1,217 @@
+#ifndef MOESI_PROTOCOL_H
+#define MOESI_PROTOCOL_H
+
+#include "moesi_types.h"
+
+// Protocol family, chosen at compile time with -DPROTOCOL=PROTOCOL_<NAME>. Every
+// variant runs on the same bus, caches and traces, so their counters compare directly.
+#define PROTOCOL_MSI 0
+#define PROTOCOL_MESI 1
+#define PROTOCOL_MESIF 2
+#define PROTOCOL_MOESI 3
+#define PROTOCOL_MOESIF 4
+#ifndef PROTOCOL
+#define PROTOCOL PROTOCOL_MOESI
+#endif
+
+// What a snooping cache does with its copy when another core's transaction finds it
+struct SnoopRule {
+    State next;              // State the copy moves to; Invalid invalidates it
+    bool supplies;           // The copy puts its data on the bus
+    bool named_supplier;     // The response names this core as the source (clean E data counts as memory's)
+    bool writeback;          // The copy is written to memory first (M answering BusRd without O)
+    unsigned char priority;  // Responder rank: a rank at least the current one takes the response; 0 stays silent
+    bool takes_update;       // The copy takes the word a BusUpd carries
+};
+
+// A protocol is the set of optional states it adds to M, S and I:
+//   Owned      a BusRd to an M line leaves it O (dirty, shared) instead of writing it back
+//   Exclusive  a BusRd nobody else holds fills in E, so a later write needs no bus transaction
+//   Forward    the newest clean sharer is F and answers BusRd cache-to-cache instead of memory
+template <bool OwnedState, bool ExclusiveState, bool ForwardState>
+struct ProtocolPolicy {
+    static constexpr bool has_owned = OwnedState;
+    static constexpr bool has_exclusive = ExclusiveState;
+    static constexpr bool has_forward = ForwardState;
+
+    static constexpr bool allows(State state) {
+        return state == State::Owned ? has_owned
+             : state == State::Exclusive ? has_exclusive
+             : state == State::Forward ? has_forward
+             : true;
+    }
+
+    // State a BusRd fill takes: E (S without it) when no other cache holds the line;
+    // otherwise F when the protocol has it and no dirty owner remains to answer, else S
+    static constexpr State readFillState(bool other_copies, bool owner_remains) {
+        return !other_copies ? (has_exclusive ? State::Exclusive : State::Shared)
+             : (has_forward && !owner_remains) ? State::Forward
+             : State::Shared;
+    }
+
+    // BusRd: the dirtiest copy answers (M > O > E > F > S), and nobody loses a valid copy
+    static constexpr SnoopRule readRule(State state) {
+        return state == State::Modified ? SnoopRule{has_owned ? State::Owned : State::Shared, true, true, !has_owned, 5, false}
+             : state == State::Owned ? SnoopRule{State::Owned, true, true, false, 4, false}
+             : state == State::Exclusive ? SnoopRule{State::Shared, true, false, false, 3, false}
+             : state == State::Forward ? SnoopRule{State::Shared, true, true, false, 2, false}
+             : SnoopRule{State::Shared, false, false, false, 1, false};
+    }
+
+    // BusRdX and BusAtomic: every copy is invalidated, a valid M, O or E copy supplies the data
+    static constexpr SnoopRule ownershipRule(State state) {
+        return state == State::Modified ? SnoopRule{State::Invalid, true, true, false, 5, false}
+             : state == State::Owned ? SnoopRule{State::Invalid, true, true, false, 4, false}
+             : state == State::Exclusive ? SnoopRule{State::Invalid, true, true, false, 3, false}
+             : SnoopRule{State::Invalid, false, false, false, 1, false};
+    }
+
+    // State a write-update store leaves the writer in. While other copies remain it
+    // owns the line (Dragon); without O the update also goes to memory and the
+    // writer stays clean (Firefly). With no other copy left the line is Modified.
+    static constexpr State updateState(bool other_copies) {
+        return !other_copies ? State::Modified
+             : has_owned ? State::Owned
+             : has_forward ? State::Forward
+             : State::Shared;
+    }
+
+    static constexpr SnoopRule snoopRule(BusOp op, State state) {
+        return state == State::Invalid || op == BusOp::BusWB || op == BusOp::None ? SnoopRule{state, false, false, false, 0, false}
+             : op == BusOp::BusRd ? readRule(state)
+             : op == BusOp::BusRdX || op == BusOp::BusAtomic ? ownershipRule(state)
+             : op == BusOp::BusUpd ? SnoopRule{State::Shared, false, false, false, 0, true}   // The writer becomes the owner
+             : SnoopRule{State::Invalid, false, false, false, 0, false};   // BusUpgr, BusInv: no data moves
+    }
+
+    // snoopRule for every (BusOp, State), indexed by their enum values; None is the last row
+    static constexpr SnoopRule snoop_table[NUM_BUS_OPS + 1][NUM_STATES] = {
+#define SNOOP_ROW(op) { snoopRule(op, State::Modified), snoopRule(op, State::Owned), snoopRule(op, State::Exclusive), \
+                        snoopRule(op, State::Shared), snoopRule(op, State::Invalid), snoopRule(op, State::Forward) }
+        SNOOP_ROW(BusOp::BusRd), SNOOP_ROW(BusOp::BusRdX), SNOOP_ROW(BusOp::BusUpgr), SNOOP_ROW(BusOp::BusWB),
+        SNOOP_ROW(BusOp::BusAtomic), SNOOP_ROW(BusOp::BusInv), SNOOP_ROW(BusOp::BusUpd), SNOOP_ROW(BusOp::None),
+#undef SNOOP_ROW
+    };
+};
+
+template <bool OwnedState, bool ExclusiveState, bool ForwardState>
+constexpr SnoopRule ProtocolPolicy<OwnedState, ExclusiveState, ForwardState>::snoop_table[NUM_BUS_OPS + 1][NUM_STATES];
+
+#if PROTOCOL == PROTOCOL_MSI
+typedef ProtocolPolicy<false, false, false> Protocol;
+#define PROTOCOL_NAME "MSI"
+#elif PROTOCOL == PROTOCOL_MESI
+typedef ProtocolPolicy<false, true, false> Protocol;
+#define PROTOCOL_NAME "MESI"
+#elif PROTOCOL == PROTOCOL_MESIF
+typedef ProtocolPolicy<false, true, true> Protocol;
+#define PROTOCOL_NAME "MESIF"
+#elif PROTOCOL == PROTOCOL_MOESI
+typedef ProtocolPolicy<true, true, false> Protocol;
+#define PROTOCOL_NAME "MOESI"
+#elif PROTOCOL == PROTOCOL_MOESIF
+typedef ProtocolPolicy<true, true, true> Protocol;
+#define PROTOCOL_NAME "MOESIF"
+#else
+#error "PROTOCOL must be one of PROTOCOL_MSI, PROTOCOL_MESI, PROTOCOL_MESIF, PROTOCOL_MOESI, PROTOCOL_MOESIF"
+#endif
+
+// Compile-time check of every snoop table cell for the selected protocol
+constexpr bool snoopRuleHolds(BusOp op, State state, const SnoopRule& rule) {
+    return (state != State::Invalid || (rule.next == State::Invalid && rule.priority == 0))
+        && (op == BusOp::BusRd || op == BusOp::BusUpd || op == BusOp::BusWB || op == BusOp::None || rule.next == State::Invalid)
+        && ((op != BusOp::BusRd && op != BusOp::BusUpd) || state == State::Invalid || rule.next != State::Invalid)
+        && (rule.takes_update == (op == BusOp::BusUpd && state != State::Invalid))                      // Every copy sees the update
+        && (!Protocol::allows(state) || Protocol::allows(rule.next))       // No way into a state the protocol lacks
+        && (op != BusOp::BusRd || (state != State::Modified && state != State::Owned)
+            || rule.next == State::Modified || rule.next == State::Owned || rule.writeback)   // Dirty data survives a BusRd
+        && (!rule.writeback || state == State::Modified)
+        && (!rule.supplies || (state != State::Shared && state != State::Invalid))
+        && (rule.priority == 0 || (op != BusOp::BusUpgr && op != BusOp::BusInv && op != BusOp::BusUpd));
+}
+
+constexpr bool snoopTableHolds(int cell) {
+    return cell == (NUM_BUS_OPS + 1) * NUM_STATES
+        || (snoopRuleHolds(static_cast<BusOp>(cell / NUM_STATES), static_cast<State>(cell % NUM_STATES),
+                           Protocol::snoop_table[cell / NUM_STATES][cell % NUM_STATES])
+            && snoopTableHolds(cell + 1));
+}
+
+static_assert(static_cast<int>(BusOp::None) == NUM_BUS_OPS, "snoop_table keeps BusOp::None as its last row");
+static_assert(snoopTableHolds(0), "snoop_table breaks a coherence rule for " PROTOCOL_NAME);
+
+// The snoop behaviour broadcastBusOperation hand-coded before snoop_table existed,
+// written out per protocol as {next, supplies, named_supplier, writeback, priority,
+// takes_update}. Columns follow State (M, O, E, S, I, F); {} marks a state the
+// protocol lacks, which no copy can be in. Unlike snoopRuleHolds these cells are
+// not derived from snoopRule, so a change to the rules must be made here as well.
+namespace snoop_reference {
+constexpr State M = State::Modified, O = State::Owned, E = State::Exclusive;
+constexpr State S = State::Shared, I = State::Invalid, F = State::Forward;
+
+constexpr SnoopRule table[NUM_BUS_OPS + 1][NUM_STATES] = {
+#if PROTOCOL == PROTOCOL_MSI
+    /* BusRd     */ {{S,1,1,1,5,0}, {}, {}, {S,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusRdX    */ {{I,1,1,0,5,0}, {}, {}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusUpgr   */ {{I,0,0,0,0,0}, {}, {}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusWB     */ {{M,0,0,0,0,0}, {}, {}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusAtomic */ {{I,1,1,0,5,0}, {}, {}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusInv    */ {{I,0,0,0,0,0}, {}, {}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusUpd    */ {{S,0,0,0,0,1}, {}, {}, {S,0,0,0,0,1}, {I,0,0,0,0,0}, {}},
+    /* None      */ {{M,0,0,0,0,0}, {}, {}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+#elif PROTOCOL == PROTOCOL_MESI
+    /* BusRd     */ {{S,1,1,1,5,0}, {}, {S,1,0,0,3,0}, {S,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusRdX    */ {{I,1,1,0,5,0}, {}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusUpgr   */ {{I,0,0,0,0,0}, {}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusWB     */ {{M,0,0,0,0,0}, {}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusAtomic */ {{I,1,1,0,5,0}, {}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusInv    */ {{I,0,0,0,0,0}, {}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusUpd    */ {{S,0,0,0,0,1}, {}, {S,0,0,0,0,1}, {S,0,0,0,0,1}, {I,0,0,0,0,0}, {}},
+    /* None      */ {{M,0,0,0,0,0}, {}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+#elif PROTOCOL == PROTOCOL_MESIF
+    /* BusRd     */ {{S,1,1,1,5,0}, {}, {S,1,0,0,3,0}, {S,0,0,0,1,0}, {I,0,0,0,0,0}, {S,1,1,0,2,0}},
+    /* BusRdX    */ {{I,1,1,0,5,0}, {}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {I,0,0,0,1,0}},
+    /* BusUpgr   */ {{I,0,0,0,0,0}, {}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}},
+    /* BusWB     */ {{M,0,0,0,0,0}, {}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {F,0,0,0,0,0}},
+    /* BusAtomic */ {{I,1,1,0,5,0}, {}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {I,0,0,0,1,0}},
+    /* BusInv    */ {{I,0,0,0,0,0}, {}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}},
+    /* BusUpd    */ {{S,0,0,0,0,1}, {}, {S,0,0,0,0,1}, {S,0,0,0,0,1}, {I,0,0,0,0,0}, {S,0,0,0,0,1}},
+    /* None      */ {{M,0,0,0,0,0}, {}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {F,0,0,0,0,0}},
+#elif PROTOCOL == PROTOCOL_MOESI
+    /* BusRd     */ {{O,1,1,0,5,0}, {O,1,1,0,4,0}, {S,1,0,0,3,0}, {S,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusRdX    */ {{I,1,1,0,5,0}, {I,1,1,0,4,0}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusUpgr   */ {{I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusWB     */ {{M,0,0,0,0,0}, {O,0,0,0,0,0}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusAtomic */ {{I,1,1,0,5,0}, {I,1,1,0,4,0}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {}},
+    /* BusInv    */ {{I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+    /* BusUpd    */ {{S,0,0,0,0,1}, {S,0,0,0,0,1}, {S,0,0,0,0,1}, {S,0,0,0,0,1}, {I,0,0,0,0,0}, {}},
+    /* None      */ {{M,0,0,0,0,0}, {O,0,0,0,0,0}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {}},
+#elif PROTOCOL == PROTOCOL_MOESIF
+    /* BusRd     */ {{O,1,1,0,5,0}, {O,1,1,0,4,0}, {S,1,0,0,3,0}, {S,0,0,0,1,0}, {I,0,0,0,0,0}, {S,1,1,0,2,0}},
+    /* BusRdX    */ {{I,1,1,0,5,0}, {I,1,1,0,4,0}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {I,0,0,0,1,0}},
+    /* BusUpgr   */ {{I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}},
+    /* BusWB     */ {{M,0,0,0,0,0}, {O,0,0,0,0,0}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {F,0,0,0,0,0}},
+    /* BusAtomic */ {{I,1,1,0,5,0}, {I,1,1,0,4,0}, {I,1,1,0,3,0}, {I,0,0,0,1,0}, {I,0,0,0,0,0}, {I,0,0,0,1,0}},
+    /* BusInv    */ {{I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}, {I,0,0,0,0,0}},
+    /* BusUpd    */ {{S,0,0,0,0,1}, {S,0,0,0,0,1}, {S,0,0,0,0,1}, {S,0,0,0,0,1}, {I,0,0,0,0,0}, {S,0,0,0,0,1}},
+    /* None      */ {{M,0,0,0,0,0}, {O,0,0,0,0,0}, {E,0,0,0,0,0}, {S,0,0,0,0,0}, {I,0,0,0,0,0}, {F,0,0,0,0,0}},
+#endif
+};
+}
+
+constexpr bool sameSnoopRule(const SnoopRule& a, const SnoopRule& b) {
+    return a.next == b.next && a.supplies == b.supplies && a.named_supplier == b.named_supplier
+        && a.writeback == b.writeback && a.priority == b.priority && a.takes_update == b.takes_update;
+}
+
+constexpr bool snoopTableMatchesReference(int cell) {
+    return cell == (NUM_BUS_OPS + 1) * NUM_STATES
+        || ((!Protocol::allows(static_cast<State>(cell % NUM_STATES))
+             || sameSnoopRule(Protocol::snoop_table[cell / NUM_STATES][cell % NUM_STATES],
+                              snoop_reference::table[cell / NUM_STATES][cell % NUM_STATES]))
+            && snoopTableMatchesReference(cell + 1));
+}
+
+static_assert(snoopTableMatchesReference(0), "snoop_table differs from the reference transitions for " PROTOCOL_NAME);
+
+#endif // MOESI_PROTOCOL_H
@@ -0,0 +1,726 @@
+#ifndef MOESI_STATS_H
+#define MOESI_STATS_H
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "moesi_types.h"
+using namespace std;
+
+// Largest core count the per-core bitmasks and histograms support
+const int MAX_CORES = 64;
+
+// Distribution of a small non-negative count (such as a number of remote copies),
+// one bucket per value. Values past the last bucket land in it.
+struct Histogram {
+    unsigned long long buckets[MAX_CORES];
+
+    Histogram() { reset(); }
+
+    void reset() { memset(buckets, 0, sizeof(buckets)); }
+
+    void add(int value) { buckets[value < MAX_CORES ? value : MAX_CORES - 1]++; }
+
+    unsigned long long samples() const {
+        unsigned long long total = 0;
+        for (int i = 0; i < MAX_CORES; i++) total += buckets[i];
+        return total;
+    }
+
+    double mean() const {
+        unsigned long long total = 0;
+        unsigned long long weighted = 0;
+        for (int i = 0; i < MAX_CORES; i++) {
+            total += buckets[i];
+            weighted += buckets[i] * i;
+        }
+        return total ? static_cast<double>(weighted) / total : 0.0;
+    }
+
+    Histogram& operator+=(const Histogram& other) {
+        for (int i = 0; i < MAX_CORES; i++) buckets[i] += other.buckets[i];
+        return *this;
+    }
+};
+
+// Per-core event counters. Aligned to a host cache line so that host threads
+// driving different simulated cores never false-share their counters.
+struct alignas(64) CoreStats {
+    unsigned long long hits[NUM_CPU_OPS];
+    unsigned long long misses[NUM_CPU_OPS];
+    unsigned long long bus_issued[NUM_BUS_OPS];              // Transactions this core put on the bus
+    unsigned long long snoop_hits[NUM_STATES];               // Snooped transactions that matched a valid line, by state at snoop time
+    unsigned long long cache_to_cache;                       // Misses whose data came from a peer cache
+    unsigned long long memory_fills;                         // Misses whose data came from memory
+    unsigned long long victim_hits;                          // L1 misses served by the victim buffer
+    unsigned long long victim_evictions;                     // Lines pushed out of a full victim buffer
+    unsigned long long wb_queued;                            // Dirty victims parked in the write-back buffer
+    unsigned long long wb_full_stalls;                       // Misses that waited for a full write-back buffer to drain
+    unsigned long long wb_forced_drains;                     // Misses to a line still waiting in the write-back buffer
+    unsigned long long l2_hits;                              // L1 misses served by the private L2
+    unsigned long long l2_misses;                            // L1 misses that also missed the private L2
+    unsigned long long l2_back_invalidations;                // L1 lines dropped to keep the private L2 inclusive
+    unsigned long long l1_snoops_filtered;                   // Snoops answered by the inclusive L2 without probing the L1
+    unsigned long long llc_hits;                             // Memory-side reads (fills, far atomics) served by the LLC
+    unsigned long long llc_misses;                           // Memory-side reads that went past the LLC to memory
+    unsigned long long llc_writebacks;                       // Dirty LLC lines written to memory by this core's requests
+    unsigned long long back_invalidations;                   // Lines this core lost to an inclusive LLC eviction
+    unsigned long long snoops_filtered;                      // Remote snoops skipped by the inclusive LLC's sharer bits
+    unsigned long long prefetches_issued;                    // Prefetch BusRds issued off the demand path
+    unsigned long long prefetch_useful;                      // Prefetched lines a demand access found still held
+    unsigned long long prefetch_late;                        // Useful prefetches whose data had not yet arrived
+    unsigned long long prefetch_late_cycles;                 // Cycles demand accesses waited on in-flight prefetches
+    unsigned long long prefetch_invalidated;                 // Prefetched lines invalidated by another core before use
+    unsigned long long prefetch_pollution;                   // Demand L1 misses on lines a prefetch displaced
+    unsigned long long rfo_reads;                            // Read misses fetched with BusRdX (PrefetchW or predicted)
+    unsigned long long rfo_predicted;                        // Plain read misses the ownership predictor turned into BusRdX
+    unsigned long long rfo_mispredicted;                     // Predicted reads missed again before any store
+    unsigned long long upgrades_avoided;                     // Stores that found a read-for-ownership line still exclusive
+    unsigned long long bulk_operations;                      // Mem_Copy/Mem_Set/Mem_Zero operations
+    unsigned long long bulk_words;                           // Destination words those operations wrote
+    unsigned long long batched_snoops;                       // Bulk bus transactions that shared an earlier one's arbitration and snoop
+    unsigned long long updates_received;                     // Copies this core held that a remote BusUpd refreshed
+    unsigned long long updates_unread;                       // Refreshed copies refreshed again before this core touched them
+    unsigned long long update_hits;                          // Accesses that hit a copy a BusUpd kept valid
+    unsigned long long update_bytes;                         // Bytes this core's BusUpd transactions put on the bus
+    unsigned long long invalidate_bytes;                     // Bytes invalidation would have cost instead: a BusUpgr per BusUpd, a BusRd per update hit
+    unsigned long long transitions[NUM_STATES][NUM_STATES];  // Line state changes, [from][to]
+    unsigned long long miss_classes[NUM_MISS_CLASSES];       // Misses by MissClass
+    Histogram read_sharers;                                  // Remote valid copies already present on each BusRd issued
+    Histogram invalidation_fanout;                           // Remote copies invalidated by each BusRdX/BusUpgr issued
+    unsigned long long far_atomics;                          // Atomics executed at memory through BusAtomic
+    unsigned long long sc_failures;                          // Store_Conditional attempts without a reservation
+    unsigned long long reservations_invalidated;             // LL reservations lost to a remote BusRdX/BusUpgr
+    unsigned long long reservations_evicted;                 // LL reservations lost to a conflict eviction
+    Histogram sc_retries;                                    // Failed SCs before each successful SC
+    unsigned long long cycles;                               // Simulated cycles spent in this core's operations
+
+    CoreStats() { reset(); }
+
+    void reset() {
+        memset(hits, 0, sizeof(hits));
+        memset(misses, 0, sizeof(misses));
+        memset(bus_issued, 0, sizeof(bus_issued));
+        memset(snoop_hits, 0, sizeof(snoop_hits));
+        cache_to_cache = 0;
+        memory_fills = 0;
+        victim_hits = 0;
+        victim_evictions = 0;
+        wb_queued = 0;
+        wb_full_stalls = 0;
+        wb_forced_drains = 0;
+        l2_hits = 0;
+        l2_misses = 0;
+        l2_back_invalidations = 0;
+        l1_snoops_filtered = 0;
+        llc_hits = 0;
+        llc_misses = 0;
+        llc_writebacks = 0;
+        back_invalidations = 0;
+        snoops_filtered = 0;
+        prefetches_issued = 0;
+        prefetch_useful = 0;
+        prefetch_late = 0;
+        prefetch_late_cycles = 0;
+        prefetch_invalidated = 0;
+        prefetch_pollution = 0;
+        rfo_reads = 0;
+        rfo_predicted = 0;
+        rfo_mispredicted = 0;
+        upgrades_avoided = 0;
+        bulk_operations = 0;
+        bulk_words = 0;
+        batched_snoops = 0;
+        updates_received = 0;
+        updates_unread = 0;
+        update_hits = 0;
+        update_bytes = 0;
+        invalidate_bytes = 0;
+        memset(transitions, 0, sizeof(transitions));
+        memset(miss_classes, 0, sizeof(miss_classes));
+        read_sharers.reset();
+        invalidation_fanout.reset();
+        far_atomics = 0;
+        sc_failures = 0;
+        reservations_invalidated = 0;
+        reservations_evicted = 0;
+        sc_retries.reset();
+        cycles = 0;
+    }
+
+    unsigned long long totalHits() const {
+        unsigned long long total = 0;
+        for (int i = 0; i < NUM_CPU_OPS; i++) total += hits[i];
+        return total;
+    }
+
+    unsigned long long totalMisses() const {
+        unsigned long long total = 0;
+        for (int i = 0; i < NUM_CPU_OPS; i++) total += misses[i];
+        return total;
+    }
+
+    CoreStats& operator+=(const CoreStats& other) {
+        for (int i = 0; i < NUM_CPU_OPS; i++) {
+            hits[i] += other.hits[i];
+            misses[i] += other.misses[i];
+        }
+        for (int i = 0; i < NUM_BUS_OPS; i++) bus_issued[i] += other.bus_issued[i];
+        for (int i = 0; i < NUM_STATES; i++) {
+            snoop_hits[i] += other.snoop_hits[i];
+            for (int j = 0; j < NUM_STATES; j++) transitions[i][j] += other.transitions[i][j];
+        }
+        for (int i = 0; i < NUM_MISS_CLASSES; i++) miss_classes[i] += other.miss_classes[i];
+        read_sharers += other.read_sharers;
+        invalidation_fanout += other.invalidation_fanout;
+        far_atomics += other.far_atomics;
+        sc_failures += other.sc_failures;
+        reservations_invalidated += other.reservations_invalidated;
+        reservations_evicted += other.reservations_evicted;
+        sc_retries += other.sc_retries;
+        cache_to_cache += other.cache_to_cache;
+        memory_fills += other.memory_fills;
+        victim_hits += other.victim_hits;
+        victim_evictions += other.victim_evictions;
+        wb_queued += other.wb_queued;
+        wb_full_stalls += other.wb_full_stalls;
+        wb_forced_drains += other.wb_forced_drains;
+        l2_hits += other.l2_hits;
+        l2_misses += other.l2_misses;
+        l2_back_invalidations += other.l2_back_invalidations;
+        l1_snoops_filtered += other.l1_snoops_filtered;
+        llc_hits += other.llc_hits;
+        llc_misses += other.llc_misses;
+        llc_writebacks += other.llc_writebacks;
+        back_invalidations += other.back_invalidations;
+        snoops_filtered += other.snoops_filtered;
+        prefetches_issued += other.prefetches_issued;
+        prefetch_useful += other.prefetch_useful;
+        prefetch_late += other.prefetch_late;
+        prefetch_late_cycles += other.prefetch_late_cycles;
+        prefetch_invalidated += other.prefetch_invalidated;
+        prefetch_pollution += other.prefetch_pollution;
+        rfo_reads += other.rfo_reads;
+        rfo_predicted += other.rfo_predicted;
+        rfo_mispredicted += other.rfo_mispredicted;
+        upgrades_avoided += other.upgrades_avoided;
+        bulk_operations += other.bulk_operations;
+        bulk_words += other.bulk_words;
+        batched_snoops += other.batched_snoops;
+        updates_received += other.updates_received;
+        updates_unread += other.updates_unread;
+        update_hits += other.update_hits;
+        update_bytes += other.update_bytes;
+        invalidate_bytes += other.invalidate_bytes;
+        cycles += other.cycles;
+        return *this;
+    }
+};
+
+// Counters about the simulator host rather than the simulated machine: how often
+// the thread driving a core found the operation lock taken, and how long it waited.
+// Kept apart from CoreStats so exported protocol counters stay deterministic.
+struct alignas(64) HostCounters {
+    unsigned long long lock_acquisitions;
+    unsigned long long lock_contended;   // Acquisitions where try_lock failed
+    unsigned long long lock_wait_ns;     // Time blocked on those acquisitions
+
+    HostCounters() : lock_acquisitions(0), lock_contended(0), lock_wait_ns(0) {}
+};
+
+// Print one counter row across all cores plus a total column. Rows that are zero
+// everywhere are skipped to keep the summary readable.
+void printStatsRow(const string& label, const CoreStats* stats, int num_cores,
+                   unsigned long long (*get)(const CoreStats&, int), int arg) {
+    unsigned long long total = 0;
+    for (int i = 0; i < num_cores; i++) total += get(stats[i], arg);
+    if (total == 0) return;
+    cout << "  " << left << setw(24) << label << right;
+    for (int i = 0; i < num_cores; i++) cout << setw(12) << get(stats[i], arg);
+    cout << setw(12) << total << endl;
+}
+
+void printHistogram(const string& title, const Histogram& histogram, const string& unit = "transactions") {
+    unsigned long long samples = histogram.samples();
+    if (samples == 0) return;
+    cout << "\n" << title << " (" << samples << " " << unit << ", mean " << fixed << setprecision(2)
+         << histogram.mean() << ")" << endl;
+    for (int i = 0; i < MAX_CORES; i++) {
+        if (histogram.buckets[i] == 0) continue;
+        double share = 100.0 * histogram.buckets[i] / samples;
+        cout << "  " << setw(3) << i << setw(12) << histogram.buckets[i] << setw(8) << share << "%  "
+             << string(static_cast<size_t>(share / 2), '#') << endl;
+    }
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+}
+
+void printStats(const CoreStats* stats, int num_cores) {
+    cout << dec << "\n=== COHERENCE STATISTICS ===\n";
+    cout << "  " << left << setw(24) << "" << right;
+    for (int i = 0; i < num_cores; i++) cout << setw(12) << ("CPU-" + to_string(i));
+    cout << setw(12) << "Total" << endl;
+
+    for (int op = 0; op < NUM_CPU_OPS; op++) {
+        string name = cpuOpToString(static_cast<CpuOp>(op));
+        printStatsRow(name + " hits", stats, num_cores, [](const CoreStats& s, int i) { return s.hits[i]; }, op);
+        printStatsRow(name + " misses", stats, num_cores, [](const CoreStats& s, int i) { return s.misses[i]; }, op);
+    }
+    for (int miss_class = 0; miss_class < NUM_MISS_CLASSES; miss_class++) {
+        printStatsRow(missClassToString(static_cast<MissClass>(miss_class)) + " misses", stats, num_cores,
+                      [](const CoreStats& s, int i) { return s.miss_classes[i]; }, miss_class);
+    }
+    for (int op = 0; op < NUM_BUS_OPS; op++) {
+        printStatsRow(busOpToString(static_cast<BusOp>(op)) + " issued", stats, num_cores,
+                      [](const CoreStats& s, int i) { return s.bus_issued[i]; }, op);
+    }
+    for (int state = 0; state < NUM_STATES; state++) {
+        printStatsRow("Snoop hits in " + stateToString(static_cast<State>(state)), stats, num_cores,
+                      [](const CoreStats& s, int i) { return s.snoop_hits[i]; }, state);
+    }
+    printStatsRow("Cache-to-cache fills", stats, num_cores, [](const CoreStats& s, int) { return s.cache_to_cache; }, 0);
+    printStatsRow("Memory fills", stats, num_cores, [](const CoreStats& s, int) { return s.memory_fills; }, 0);
+    printStatsRow("Victim buffer hits", stats, num_cores, [](const CoreStats& s, int) { return s.victim_hits; }, 0);
+    printStatsRow("Victim buffer evictions", stats, num_cores, [](const CoreStats& s, int) { return s.victim_evictions; }, 0);
+    printStatsRow("Write-backs buffered", stats, num_cores, [](const CoreStats& s, int) { return s.wb_queued; }, 0);
+    printStatsRow("WB buffer full stalls", stats, num_cores, [](const CoreStats& s, int) { return s.wb_full_stalls; }, 0);
+    printStatsRow("WB buffer forced drains", stats, num_cores, [](const CoreStats& s, int) { return s.wb_forced_drains; }, 0);
+    printStatsRow("L2 hits", stats, num_cores, [](const CoreStats& s, int) { return s.l2_hits; }, 0);
+    printStatsRow("L2 misses", stats, num_cores, [](const CoreStats& s, int) { return s.l2_misses; }, 0);
+    printStatsRow("L2 back-invalidations", stats, num_cores, [](const CoreStats& s, int) { return s.l2_back_invalidations; }, 0);
+    printStatsRow("L1 snoops filtered", stats, num_cores, [](const CoreStats& s, int) { return s.l1_snoops_filtered; }, 0);
+    printStatsRow("LLC hits", stats, num_cores, [](const CoreStats& s, int) { return s.llc_hits; }, 0);
+    printStatsRow("LLC misses", stats, num_cores, [](const CoreStats& s, int) { return s.llc_misses; }, 0);
+    printStatsRow("LLC write-backs", stats, num_cores, [](const CoreStats& s, int) { return s.llc_writebacks; }, 0);
+    printStatsRow("Back-invalidations", stats, num_cores, [](const CoreStats& s, int) { return s.back_invalidations; }, 0);
+    printStatsRow("Snoops filtered", stats, num_cores, [](const CoreStats& s, int) { return s.snoops_filtered; }, 0);
+    printStatsRow("Prefetches issued", stats, num_cores, [](const CoreStats& s, int) { return s.prefetches_issued; }, 0);
+    printStatsRow("Prefetches useful", stats, num_cores, [](const CoreStats& s, int) { return s.prefetch_useful; }, 0);
+    printStatsRow("Prefetches late", stats, num_cores, [](const CoreStats& s, int) { return s.prefetch_late; }, 0);
+    printStatsRow("Prefetch late cycles", stats, num_cores, [](const CoreStats& s, int) { return s.prefetch_late_cycles; }, 0);
+    printStatsRow("Prefetches invalidated", stats, num_cores, [](const CoreStats& s, int) { return s.prefetch_invalidated; }, 0);
+    printStatsRow("Prefetch pollution", stats, num_cores, [](const CoreStats& s, int) { return s.prefetch_pollution; }, 0);
+    printStatsRow("Ownership reads", stats, num_cores, [](const CoreStats& s, int) { return s.rfo_reads; }, 0);
+    printStatsRow("RFO predictions", stats, num_cores, [](const CoreStats& s, int) { return s.rfo_predicted; }, 0);
+    printStatsRow("RFO mispredictions", stats, num_cores, [](const CoreStats& s, int) { return s.rfo_mispredicted; }, 0);
+    printStatsRow("BusUpgr avoided", stats, num_cores, [](const CoreStats& s, int) { return s.upgrades_avoided; }, 0);
+    printStatsRow("Bulk operations", stats, num_cores, [](const CoreStats& s, int) { return s.bulk_operations; }, 0);
+    printStatsRow("Bulk words", stats, num_cores, [](const CoreStats& s, int) { return s.bulk_words; }, 0);
+    printStatsRow("Batched snoops", stats, num_cores, [](const CoreStats& s, int) { return s.batched_snoops; }, 0);
+    printStatsRow("Updates received", stats, num_cores, [](const CoreStats& s, int) { return s.updates_received; }, 0);
+    printStatsRow("Updates unread", stats, num_cores, [](const CoreStats& s, int) { return s.updates_unread; }, 0);
+    printStatsRow("Update hits", stats, num_cores, [](const CoreStats& s, int) { return s.update_hits; }, 0);
+    printStatsRow("Update bus bytes", stats, num_cores, [](const CoreStats& s, int) { return s.update_bytes; }, 0);
+    printStatsRow("Invalidate bus bytes", stats, num_cores, [](const CoreStats& s, int) { return s.invalidate_bytes; }, 0);
+    printStatsRow("Cycles", stats, num_cores, [](const CoreStats& s, int) { return s.cycles; }, 0);
+    printStatsRow("Far atomics", stats, num_cores, [](const CoreStats& s, int) { return s.far_atomics; }, 0);
+    printStatsRow("SC failures", stats, num_cores, [](const CoreStats& s, int) { return s.sc_failures; }, 0);
+    printStatsRow("Reservations invalidated", stats, num_cores, [](const CoreStats& s, int) { return s.reservations_invalidated; }, 0);
+    printStatsRow("Reservations evicted", stats, num_cores, [](const CoreStats& s, int) { return s.reservations_evicted; }, 0);
+    for (int from = 0; from < NUM_STATES; from++) {
+        for (int to = 0; to < NUM_STATES; to++) {
+            string name = "Transition " + stateToString(static_cast<State>(from)) + "->" + stateToString(static_cast<State>(to));
+            printStatsRow(name, stats, num_cores,
+                          [](const CoreStats& s, int i) { return s.transitions[i / NUM_STATES][i % NUM_STATES]; },
+                          from * NUM_STATES + to);
+        }
+    }
+
+    CoreStats total;
+    for (int i = 0; i < num_cores; i++) total += stats[i];
+    printHistogram("Sharers already present on BusRd", total.read_sharers);
+    printHistogram("Copies invalidated per BusRdX/BusUpgr", total.invalidation_fanout);
+    printHistogram("Failed attempts before each successful SC", total.sc_retries, "successful SCs");
+}
+
+// ============================================
+// MACHINE-READABLE EXPORT
+// ============================================
+
+// One exported counter value: metric name, label pairs and value
+struct StatSample {
+    string metric;
+    vector<pair<string, string> > labels;
+    unsigned long long value;
+};
+
+// Flatten one core's counters into samples. Every core yields the same metrics in
+// the same order, zero or not, so the exported schema never changes between runs.
+vector<StatSample> collectSamples(const CoreStats& stats, int num_cores) {
+    vector<StatSample> samples;
+    typedef vector<pair<string, string> > Labels;
+    for (int op = 0; op < NUM_CPU_OPS; op++) {
+        samples.push_back({"hits", Labels{{"op", cpuOpToString(static_cast<CpuOp>(op))}}, stats.hits[op]});
+    }
+    for (int op = 0; op < NUM_CPU_OPS; op++) {
+        samples.push_back({"misses", Labels{{"op", cpuOpToString(static_cast<CpuOp>(op))}}, stats.misses[op]});
+    }
+    for (int miss_class = 0; miss_class < NUM_MISS_CLASSES; miss_class++) {
+        samples.push_back({"miss_classes", Labels{{"class", missClassToString(static_cast<MissClass>(miss_class))}},
+                           stats.miss_classes[miss_class]});
+    }
+    for (int op = 0; op < NUM_BUS_OPS; op++) {
+        samples.push_back({"bus_transactions", Labels{{"op", busOpToString(static_cast<BusOp>(op))}}, stats.bus_issued[op]});
+    }
+    for (int state = 0; state < NUM_STATES; state++) {
+        samples.push_back({"snoop_hits", Labels{{"state", stateToString(static_cast<State>(state))}}, stats.snoop_hits[state]});
+    }
+    samples.push_back({"cache_to_cache_fills", Labels(), stats.cache_to_cache});
+    samples.push_back({"memory_fills", Labels(), stats.memory_fills});
+    samples.push_back({"victim_hits", Labels(), stats.victim_hits});
+    samples.push_back({"victim_evictions", Labels(), stats.victim_evictions});
+    samples.push_back({"wb_queued", Labels(), stats.wb_queued});
+    samples.push_back({"wb_full_stalls", Labels(), stats.wb_full_stalls});
+    samples.push_back({"wb_forced_drains", Labels(), stats.wb_forced_drains});
+    samples.push_back({"l2_hits", Labels(), stats.l2_hits});
+    samples.push_back({"l2_misses", Labels(), stats.l2_misses});
+    samples.push_back({"l2_back_invalidations", Labels(), stats.l2_back_invalidations});
+    samples.push_back({"l1_snoops_filtered", Labels(), stats.l1_snoops_filtered});
+    samples.push_back({"llc_hits", Labels(), stats.llc_hits});
+    samples.push_back({"llc_misses", Labels(), stats.llc_misses});
+    samples.push_back({"llc_writebacks", Labels(), stats.llc_writebacks});
+    samples.push_back({"back_invalidations", Labels(), stats.back_invalidations});
+    samples.push_back({"snoops_filtered", Labels(), stats.snoops_filtered});
+    samples.push_back({"prefetches_issued", Labels(), stats.prefetches_issued});
+    samples.push_back({"prefetch_useful", Labels(), stats.prefetch_useful});
+    samples.push_back({"prefetch_late", Labels(), stats.prefetch_late});
+    samples.push_back({"prefetch_late_cycles", Labels(), stats.prefetch_late_cycles});
+    samples.push_back({"prefetch_invalidated", Labels(), stats.prefetch_invalidated});
+    samples.push_back({"prefetch_pollution", Labels(), stats.prefetch_pollution});
+    samples.push_back({"rfo_reads", Labels(), stats.rfo_reads});
+    samples.push_back({"rfo_predicted", Labels(), stats.rfo_predicted});
+    samples.push_back({"rfo_mispredicted", Labels(), stats.rfo_mispredicted});
+    samples.push_back({"upgrades_avoided", Labels(), stats.upgrades_avoided});
+    samples.push_back({"bulk_operations", Labels(), stats.bulk_operations});
+    samples.push_back({"bulk_words", Labels(), stats.bulk_words});
+    samples.push_back({"batched_snoops", Labels(), stats.batched_snoops});
+    samples.push_back({"updates_received", Labels(), stats.updates_received});
+    samples.push_back({"updates_unread", Labels(), stats.updates_unread});
+    samples.push_back({"update_hits", Labels(), stats.update_hits});
+    samples.push_back({"update_bytes", Labels(), stats.update_bytes});
+    samples.push_back({"invalidate_bytes", Labels(), stats.invalidate_bytes});
+    samples.push_back({"cycles", Labels(), stats.cycles});
+    samples.push_back({"far_atomics", Labels(), stats.far_atomics});
+    samples.push_back({"sc_failures", Labels(), stats.sc_failures});
+    samples.push_back({"reservations_invalidated", Labels(), stats.reservations_invalidated});
+    samples.push_back({"reservations_evicted", Labels(), stats.reservations_evicted});
+    for (int from = 0; from < NUM_STATES; from++) {
+        for (int to = 0; to < NUM_STATES; to++) {
+            samples.push_back({"transitions", Labels{{"from", stateToString(static_cast<State>(from))},
+                                                     {"to", stateToString(static_cast<State>(to))}},
+                               stats.transitions[from][to]});
+        }
+    }
+    for (int copies = 0; copies < num_cores && copies < MAX_CORES; copies++) {
+        samples.push_back({"read_sharers", Labels{{"copies", to_string(copies)}}, stats.read_sharers.buckets[copies]});
+    }
+    for (int copies = 0; copies < num_cores && copies < MAX_CORES; copies++) {
+        samples.push_back({"invalidation_fanout", Labels{{"copies", to_string(copies)}}, stats.invalidation_fanout.buckets[copies]});
+    }
+    for (int retries = 0; retries < MAX_CORES; retries++) {
+        samples.push_back({"sc_retries", Labels{{"failures", to_string(retries)}}, stats.sc_retries.buckets[retries]});
+    }
+    return samples;
+}
+
+string metricHelp(const string& metric) {
+    if (metric == "hits") return "Cache hits by CPU operation.";
+    if (metric == "misses") return "Cache misses by CPU operation.";
+    if (metric == "miss_classes") return "Cache misses by cause.";
+    if (metric == "bus_transactions") return "Bus transactions issued by the core.";
+    if (metric == "snoop_hits") return "Snooped transactions that matched a valid line, by line state.";
+    if (metric == "cache_to_cache_fills") return "Misses served by a peer cache.";
+    if (metric == "memory_fills") return "Misses served by memory.";
+    if (metric == "victim_hits") return "L1 misses served by the victim buffer.";
+    if (metric == "victim_evictions") return "Lines pushed out of a full victim buffer.";
+    if (metric == "wb_queued") return "Dirty victims parked in the write-back buffer.";
+    if (metric == "wb_full_stalls") return "Misses that stalled until a full write-back buffer drained an entry.";
+    if (metric == "wb_forced_drains") return "Misses that had to finish a pending write-back of the same line first.";
+    if (metric == "l2_hits") return "L1 misses served by the private L2.";
+    if (metric == "l2_misses") return "L1 misses that also missed the private L2.";
+    if (metric == "l2_back_invalidations") return "L1 lines invalidated to keep the private L2 inclusive.";
+    if (metric == "l1_snoops_filtered") return "Snoops the inclusive private L2 answered without probing the L1.";
+    if (metric == "llc_hits") return "Memory-side reads served by the shared last-level cache.";
+    if (metric == "llc_misses") return "Memory-side reads that missed the shared last-level cache.";
+    if (metric == "llc_writebacks") return "Dirty last-level cache lines written back to memory.";
+    if (metric == "back_invalidations") return "Private cache lines invalidated to keep the last-level cache inclusive.";
+    if (metric == "snoops_filtered") return "Remote snoops skipped because the inclusive last-level cache showed no copy.";
+    if (metric == "prefetches_issued") return "Prefetch reads issued by the core's hardware prefetcher.";
+    if (metric == "prefetch_useful") return "Prefetched lines a later demand access found still in the core.";
+    if (metric == "prefetch_late") return "Useful prefetches whose fill was still in flight at the demand access.";
+    if (metric == "prefetch_late_cycles") return "Cycles demand accesses waited for in-flight prefetch fills.";
+    if (metric == "prefetch_invalidated") return "Prefetched lines invalidated by another core before any demand access.";
+    if (metric == "prefetch_pollution") return "Demand L1 misses on lines a prefetch had displaced.";
+    if (metric == "rfo_reads") return "Read misses that fetched the line for ownership with BusRdX.";
+    if (metric == "rfo_predicted") return "Read misses the ownership predictor turned into BusRdX.";
+    if (metric == "rfo_mispredicted") return "Predicted reads for ownership whose line was read again before any store.";
+    if (metric == "upgrades_avoided") return "Stores that found a line read for ownership still exclusive, saving a BusUpgr.";
+    if (metric == "bulk_operations") return "Bulk copy, set and zero operations executed.";
+    if (metric == "bulk_words") return "Destination words written by bulk operations.";
+    if (metric == "batched_snoops") return "Bus transactions of bulk operations that rode in an earlier transaction's snoop batch.";
+    if (metric == "updates_received") return "Cached copies refreshed in place by another core's BusUpd.";
+    if (metric == "updates_unread") return "Refreshed copies refreshed again before the core accessed them.";
+    if (metric == "update_hits") return "Accesses that hit a copy a BusUpd kept valid, which invalidation would have turned into misses.";
+    if (metric == "update_bytes") return "Bytes put on the bus by the core's BusUpd transactions.";
+    if (metric == "invalidate_bytes") return "Estimated bytes the same stores would have cost under invalidation: a BusUpgr each plus the BusRds of the misses avoided.";
+    if (metric == "cycles") return "Simulated cycles spent in the core's operations.";
+    if (metric == "transitions") return "Cache line state transitions.";
+    if (metric == "read_sharers") return "BusRd transactions by number of remote copies already present.";
+    if (metric == "far_atomics") return "Atomics executed at memory instead of in the cache.";
+    if (metric == "sc_failures") return "Store-conditionals that failed for lack of a reservation.";
+    if (metric == "reservations_invalidated") return "Load-linked reservations cleared by a remote invalidation.";
+    if (metric == "reservations_evicted") return "Load-linked reservations cleared by a conflict eviction.";
+    if (metric == "sc_retries") return "Successful store-conditionals by number of failed attempts before them.";
+    if (metric == "invalidation_fanout") return "BusRdX/BusUpgr transactions by number of remote copies invalidated.";
+    return metric + " counter.";
+}
+
+string labelKey(const StatSample& sample) {
+    string key;
+    for (size_t i = 0; i < sample.labels.size(); i++) {
+        if (i) key += "->";
+        key += sample.labels[i].second;
+    }
+    return key;
+}
+
+// {"operations": N, "cores": [{"core": 0, "hits": {"Read": 3, ...}, "memory_fills": 5, ...}, ...]}
+string formatStatsJson(const CoreStats* stats, int num_cores, unsigned long long operations) {
+    ostringstream out;
+    out << "{\n  \"timestamp\": " << time(nullptr) << ",\n  \"operations\": " << operations << ",\n  \"cores\": [";
+    for (int core = 0; core < num_cores; core++) {
+        vector<StatSample> samples = collectSamples(stats[core], num_cores);
+        out << (core ? "," : "") << "\n    {\"core\": " << core;
+        for (size_t i = 0; i < samples.size(); i++) {
+            bool first_of_metric = (i == 0 || samples[i - 1].metric != samples[i].metric);
+            bool last_of_metric = (i + 1 == samples.size() || samples[i + 1].metric != samples[i].metric);
+            if (samples[i].labels.empty()) {
+                out << ", \"" << samples[i].metric << "\": " << samples[i].value;
+                continue;
+            }
+            if (first_of_metric) out << ", \"" << samples[i].metric << "\": {";
+            else out << ", ";
+            out << "\"" << labelKey(samples[i]) << "\": " << samples[i].value;
+            if (last_of_metric) out << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+// Long format, one counter per row: core,metric,label,value
+string formatStatsCsv(const CoreStats* stats, int num_cores, unsigned long long operations) {
+    ostringstream out;
+    out << "core,metric,label,value\n";
+    out << "all,operations,," << operations << "\n";
+    for (int core = 0; core < num_cores; core++) {
+        vector<StatSample> samples = collectSamples(stats[core], num_cores);
+        for (size_t i = 0; i < samples.size(); i++) {
+            out << core << "," << samples[i].metric << "," << labelKey(samples[i]) << "," << samples[i].value << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Prometheus text exposition format, as read by the node-exporter textfile collector
+string formatStatsPrometheus(const CoreStats* stats, int num_cores, unsigned long long operations) {
+    ostringstream out;
+    out << "# HELP moesi_operations_total CPU operations completed by the simulator.\n"
+        << "# TYPE moesi_operations_total counter\n"
+        << "moesi_operations_total " << operations << "\n";
+
+    vector<vector<StatSample> > per_core;
+    for (int core = 0; core < num_cores; core++) {
+        per_core.push_back(collectSamples(stats[core], num_cores));
+    }
+    if (per_core.empty()) return out.str();
+
+    for (size_t i = 0; i < per_core[0].size(); i++) {
+        const string& metric = per_core[0][i].metric;
+        if (i == 0 || per_core[0][i - 1].metric != metric) {
+            out << "# HELP moesi_" << metric << "_total " << metricHelp(metric) << "\n"
+                << "# TYPE moesi_" << metric << "_total counter\n";
+        }
+        for (int core = 0; core < num_cores; core++) {
+            const StatSample& sample = per_core[core][i];
+            out << "moesi_" << metric << "_total{core=\"" << core << "\"";
+            for (size_t l = 0; l < sample.labels.size(); l++) {
+                out << "," << sample.labels[l].first << "=\"" << sample.labels[l].second << "\"";
+            }
+            out << "} " << sample.value << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Write a file so that readers never see it half-written: write a temporary file
+// next to it, then rename it over the target.
+bool writeFileAtomically(const string& path, const string& contents) {
+    string temporary = path + ".tmp." + to_string(getpid());
+    {
+        ofstream out(temporary.c_str(), ios::out | ios::trunc);
+        out << contents;
+        out.flush();
+        if (!out) {
+            cerr << "ERROR: cannot write " << temporary << endl;
+            remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        cerr << "ERROR: cannot rename " << temporary << " to " << path << endl;
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Writes the counters to whichever of the JSON, CSV and Prometheus paths are set,
+// at the end of the run and, if interval is non-zero, every interval operations.
+struct StatsExporter {
+    string json_path;
+    string csv_path;
+    string prometheus_path;
+    unsigned long long interval;
+
+    StatsExporter() : interval(0) {}
+
+    bool enabled() const { return !json_path.empty() || !csv_path.empty() || !prometheus_path.empty(); }
+
+    bool write(const CoreStats* stats, int num_cores, unsigned long long operations) const {
+        bool ok = true;
+        if (!json_path.empty()) ok = writeFileAtomically(json_path, formatStatsJson(stats, num_cores, operations)) && ok;
+        if (!csv_path.empty()) ok = writeFileAtomically(csv_path, formatStatsCsv(stats, num_cores, operations)) && ok;
+        if (!prometheus_path.empty()) ok = writeFileAtomically(prometheus_path, formatStatsPrometheus(stats, num_cores, operations)) && ok;
+        return ok;
+    }
+};
+
+// ============================================
+// TIME SERIES
+// ============================================
+
+// Snapshots of every core's counters, taken each time the operation count or the
+// simulated cycle count crosses a multiple of the interval. Snapshots go into a
+// ring buffer allocated up front; once it is full the oldest is overwritten.
+//
+// dump() writes the buffer to a memory-mapped file, oldest snapshot first, as
+// native-endian 64-bit words:
+//   header   "MOESITS\0", version, num_cores, num_metrics, num_records, names_bytes
+//   names    num_metrics NUL-terminated "metric{label=value,...}" strings, zero-padded to 8 bytes
+//   records  num_records x (operations, cycle, num_cores x num_metrics values in name order)
+class TimeSeriesRecorder {
+private:
+    int num_cores;
+    size_t capacity;
+    unsigned long long interval;
+    bool by_cycles;
+    unsigned long long next_boundary;
+    vector<unsigned long long> operations;  // Per slot
+    vector<unsigned long long> cycles;      // Per slot
+    vector<CoreStats> counters;             // capacity x num_cores
+    size_t next_slot;
+    size_t recorded;
+
+public:
+    TimeSeriesRecorder(int num_cores, size_t capacity, unsigned long long interval, bool by_cycles)
+        : num_cores(num_cores), capacity(capacity), interval(interval), by_cycles(by_cycles),
+          next_boundary(interval), operations(capacity), cycles(capacity),
+          counters(capacity * num_cores), next_slot(0), recorded(0) {}
+
+    // True if a snapshot is due at this point. Advances to the next boundary.
+    bool due(unsigned long long operations_now, unsigned long long cycle_now) {
+        unsigned long long clock = by_cycles ? cycle_now : operations_now;
+        if (interval == 0 || capacity == 0 || clock < next_boundary) return false;
+        next_boundary = (clock / interval + 1) * interval;
+        return true;
+    }
+
+    // Claim the next slot. The caller fills in num_cores counter blocks.
+    CoreStats* beginSnapshot(unsigned long long operations_now, unsigned long long cycle_now) {
+        size_t slot = next_slot;
+        next_slot = (next_slot + 1) % capacity;
+        if (recorded < capacity) recorded++;
+        operations[slot] = operations_now;
+        cycles[slot] = cycle_now;
+        return &counters[slot * num_cores];
+    }
+
+    size_t size() const { return recorded; }
+
+    bool dump(const string& path) const {
+        vector<StatSample> layout = collectSamples(CoreStats(), num_cores);
+        string names;
+        for (size_t i = 0; i < layout.size(); i++) {
+            names += layout[i].metric + "{";
+            for (size_t l = 0; l < layout[i].labels.size(); l++) {
+                names += (l ? "," : "") + layout[i].labels[l].first + "=" + layout[i].labels[l].second;
+            }
+            names += "}";
+            names.push_back('\0');
+        }
+        names.resize((names.size() + 7) / 8 * 8, '\0');
+
+        const size_t header_words = 6;
+        const size_t record_words = 2 + num_cores * layout.size();
+        const size_t bytes = header_words * 8 + names.size() + recorded * record_words * 8;
+
+        string temporary = path + ".tmp." + to_string(getpid());
+        int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            cerr << "ERROR: cannot create " << temporary << endl;
+            return false;
+        }
+        void* mapping = MAP_FAILED;
+        if (ftruncate(fd, bytes) == 0) {
+            mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (mapping == MAP_FAILED) {
+            cerr << "ERROR: cannot map " << temporary << endl;
+            close(fd);
+            remove(temporary.c_str());
+            return false;
+        }
+
+        char* base = static_cast<char*>(mapping);
+        unsigned long long header[header_words] = {0, 1, static_cast<unsigned long long>(num_cores), layout.size(), recorded, names.size()};
+        memcpy(header, "MOESITS", 8);
+        memcpy(base, header, sizeof(header));
+        memcpy(base + sizeof(header), names.data(), names.size());
+
+        unsigned long long* out = reinterpret_cast<unsigned long long*>(base + sizeof(header) + names.size());
+        size_t oldest = (recorded < capacity) ? 0 : next_slot;
+        for (size_t r = 0; r < recorded; r++) {
+            size_t slot = (oldest + r) % capacity;
+            *out++ = operations[slot];
+            *out++ = cycles[slot];
+            for (int core = 0; core < num_cores; core++) {
+                vector<StatSample> values = collectSamples(counters[slot * num_cores + core], num_cores);
+                for (size_t i = 0; i < values.size(); i++) *out++ = values[i].value;
+            }
+        }
+
+        bool ok = msync(mapping, bytes, MS_SYNC) == 0;
+        munmap(mapping, bytes);
+        close(fd);
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            cerr << "ERROR: cannot write " << path << endl;
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // MOESI_STATS_H
@@ -1,16 +1,33 @@
 #ifndef MOESI_TYPES_H
 #define MOESI_TYPES_H
 
+#include <cstdint>
 #include <string>
+#include <type_traits>
 using namespace std;
 
+// Width of a memory word and of atomic operands. Build with -DWORD_BITS=64 for 64-bit words.
+#ifndef WORD_BITS
+#define WORD_BITS 32
+#endif
+#if WORD_BITS == 64
+typedef int64_t word_t;
+#elif WORD_BITS == 32
+typedef int32_t word_t;
+#else
+#error "WORD_BITS must be 32 or 64"
+#endif
+typedef make_unsigned<word_t>::type uword_t;  // Wrapping arithmetic for the atomic ALU
+
 enum class State {
     Modified,   // Data is valid, dirty (different from main memory), only in this cache.
     Owned,      // Data is valid, dirty, may be in other caches (not in MESI, but in MOESI)
     Exclusive,  // Data is valid, clean (same as main memory), only in this cache.
     Shared,     // Data is valid, clean, may be in other caches.
     Invalid,    // Data is not valid, must be fetched before use.
+    Forward,    // Data is valid, clean, may be in other caches; this copy answers BusRd (MESIF/MOESIF only).
 };
+const int NUM_STATES = 6;
 
 enum class CpuOp {
     Read,          // Standard load: read data from memory or cache.
@@ -24,25 +41,147 @@ enum class CpuOp {
     Atomic_NAND,   // Atomic Nand: atomic bitwise nand of the value at the address.
     Atomic_NOR,    // Atomic Nor: atomic bitwise nor of the value at the address.
     Atomic_XNOR,   // Atomic Xnor: atomic bitwise xnor of the value at the address.
+    Load_Linked,        // Load-Linked: read that also places a reservation on the address.
+    Store_Conditional,  // Store-Conditional: write that succeeds only while this core's reservation holds.
+    PrefetchW,          // Read for ownership: load that fetches the line with BusRdX, so a following store needs no BusUpgr.
+    Store_NT,           // Non-temporal store of a whole line: a miss claims the line with BusInv and fetches no data.
+    Mem_Copy,           // Bulk copy: value is the source address, expected the length in bytes.
+    Mem_Set,            // Bulk set: every word in the range gets value; expected is the length in bytes.
+    Mem_Zero,           // Bulk zero: value is the length in bytes.
 };
+const int NUM_CPU_OPS = 18;
+
+// True for the bus-locked read-modify-write operations (Atomic_CAS to Atomic_XNOR)
+bool isAtomicOp(CpuOp op) {
+    return op >= CpuOp::Atomic_CAS && op <= CpuOp::Atomic_XNOR;
+}
+
+// True for the operations over an address range (Mem_Copy, Mem_Set, Mem_Zero)
+bool isBulkOp(CpuOp op) {
+    return op >= CpuOp::Mem_Copy && op <= CpuOp::Mem_Zero;
+}
 
 enum class BusOp {
     BusRd,      // Bus Read: Request for a cache line to read (Shared or Exclusive).  Issued on a read miss.
     BusRdX,     // Bus Read Exclusive (Read-for-Ownership): Request for a cache line to perform a write. Fetches the latest data and invalidates all other sharers.
     BusUpgr,    // Bus Upgrade: Request to upgrade an existing Shared line to Modified state without data transfer. Invalidates all other sharers.
     BusWB,      // Bus Write-Back: Write back a Modified or Owned cache line to memory (typically on eviction or replacement).
+    BusAtomic,  // Bus Atomic: Far atomic executed at memory. Invalidates every cached copy (a dirty one supplies its data first); nobody allocates the line.
+    BusInv,     // Bus Invalidate: Claim a line the requester will overwrite in full. Invalidates every other copy; no data moves, so dirty copies are discarded.
+    BusUpd,     // Bus Update: Write-update store to a shared line. Carries the new word to every other copy, which stays valid; nothing is invalidated.
     None        // No bus operation.
 };
+const int NUM_BUS_OPS = 7;  // Real transactions only (None excluded)
+
+// Why a miss happened. Coherence misses are split by whether any store touched the
+// word between the invalidation and the miss. With one word per line this is not
+// false sharing: a silent invalidation comes from a transaction that changed no data,
+// such as a failed CAS or a PrefetchW that no store followed.
+enum class MissClass {
+    Compulsory,     // First access to the address by this core.
+    Capacity,       // Would also miss in a fully-associative cache of the same size.
+    Conflict,       // Would hit in a fully-associative cache of the same size.
+    TrueSharing,    // Line was invalidated by a remote write to the word now accessed.
+    SilentInvalidation, // Line was invalidated, but no store touched the word now accessed.
+};
+const int NUM_MISS_CLASSES = 5;
 
 struct BusResponse {
-    int data;
+    word_t data;
     bool data_from_memory;
+    bool data_from_llc;     // With data_from_memory: served by the shared LLC rather than memory
     State requester_new_state;
     bool state_changed;
     State present_state;
     int core_id;  // ID of the core that supplied the data
 };
 
+// Where an atomic read-modify-write executes
+enum class AtomicPolicy {
+    Near,       // In the requester's cache: BusRdX/BusUpgr, then the line is Modified there.
+    Far,        // At memory with one BusAtomic; the line is left uncached.
+    Adaptive,   // Far for addresses whose atomics keep moving between cores, near otherwise.
+};
+
+string atomicPolicyToString(AtomicPolicy policy) {
+    switch (policy) {
+        case AtomicPolicy::Near: return "near";
+        case AtomicPolicy::Far: return "far";
+        case AtomicPolicy::Adaptive: return "adaptive";
+        default: return "unknown";
+    }
+}
+
+bool stringToAtomicPolicy(const string& name, AtomicPolicy& policy) {
+    for (AtomicPolicy candidate : {AtomicPolicy::Near, AtomicPolicy::Far, AtomicPolicy::Adaptive}) {
+        if (atomicPolicyToString(candidate) == name) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// How the shared last-level cache relates to the private caches
+enum class LLCPolicy {
+    None,           // No LLC: misses go straight to memory.
+    Inclusive,      // Holds every privately cached line; evictions back-invalidate, sharer bits filter snoops.
+    NonInclusive,   // Fills on every memory read, evicts without touching the private caches.
+    Exclusive,      // Victim cache: filled by private-cache evictions, a hit moves the line out.
+};
+
+string llcPolicyToString(LLCPolicy policy) {
+    switch (policy) {
+        case LLCPolicy::None: return "none";
+        case LLCPolicy::Inclusive: return "inclusive";
+        case LLCPolicy::NonInclusive: return "non-inclusive";
+        case LLCPolicy::Exclusive: return "exclusive";
+        default: return "unknown";
+    }
+}
+
+bool stringToLLCPolicy(const string& name, LLCPolicy& policy) {
+    for (LLCPolicy candidate : {LLCPolicy::None, LLCPolicy::Inclusive, LLCPolicy::NonInclusive, LLCPolicy::Exclusive}) {
+        if (llcPolicyToString(candidate) == name) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// How each core's private L2 relates to its L1
+enum class L2Policy {
+    None,           // L1 only.
+    Inclusive,      // Every L1 line has an L2 entry; an L2 eviction back-invalidates the L1 copy.
+    Exclusive,      // A line is in one level or the other; L1 victims move down, L2 hits move up.
+};
+
+string l2PolicyToString(L2Policy policy) {
+    switch (policy) {
+        case L2Policy::None: return "none";
+        case L2Policy::Inclusive: return "inclusive";
+        case L2Policy::Exclusive: return "exclusive";
+        default: return "unknown";
+    }
+}
+
+bool stringToL2Policy(const string& name, L2Policy& policy) {
+    for (L2Policy candidate : {L2Policy::None, L2Policy::Inclusive, L2Policy::Exclusive}) {
+        if (l2PolicyToString(candidate) == name) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// What a CPU operation returns to the simulated program
+struct CpuResult {
+    word_t value;   // The word before the operation (for a Read, the value read)
+    bool success;   // False only for a failed Atomic_CAS or Store_Conditional
+};
+
 string stateToString(State state) {
     switch (state) {
         case State::Modified: return "M";
@@ -50,6 +189,7 @@ string stateToString(State state) {
         case State::Exclusive: return "E";
         case State::Shared: return "S";
         case State::Invalid: return "I";
+        case State::Forward: return "F";
         default: return "Unknown";
     }
 }
@@ -67,21 +207,54 @@ string cpuOpToString(CpuOp op) {
         case CpuOp::Atomic_NAND: return "Atomic_NAND";
         case CpuOp::Atomic_NOR: return "Atomic_NOR";
         case CpuOp::Atomic_XNOR: return "Atomic_XNOR";
+        case CpuOp::Load_Linked: return "Load_Linked";
+        case CpuOp::Store_Conditional: return "Store_Conditional";
+        case CpuOp::PrefetchW: return "PrefetchW";
+        case CpuOp::Store_NT: return "Store_NT";
+        case CpuOp::Mem_Copy: return "Mem_Copy";
+        case CpuOp::Mem_Set: return "Mem_Set";
+        case CpuOp::Mem_Zero: return "Mem_Zero";
         default: return "Unknown";
     }
 }
 
+// Inverse of cpuOpToString, used when reading trace files.
+bool stringToCpuOp(const string& name, CpuOp& op) {
+    for (int i = 0; i < NUM_CPU_OPS; i++) {
+        CpuOp candidate = static_cast<CpuOp>(i);
+        if (cpuOpToString(candidate) == name) {
+            op = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
 string busOpToString(BusOp op) {
     switch (op) {
         case BusOp::BusRd: return "BusRd";
         case BusOp::BusRdX: return "BusRdX";
         case BusOp::BusUpgr: return "BusUpgr";
         case BusOp::BusWB: return "BusWB";
+        case BusOp::BusAtomic: return "BusAtomic";
+        case BusOp::BusInv: return "BusInv";
+        case BusOp::BusUpd: return "BusUpd";
         case BusOp::None: return "None";
         default: return "Unknown";
     }
 }
 
+string missClassToString(MissClass miss_class) {
+    switch (miss_class) {
+        case MissClass::Compulsory: return "Compulsory";
+        case MissClass::Capacity: return "Capacity";
+        case MissClass::Conflict: return "Conflict";
+        case MissClass::TrueSharing: return "True sharing";
+        case MissClass::SilentInvalidation: return "Silent invalidation";
+        default: return "Unknown";
+    }
+}
+
 // Forward declarations
 class Processor;
 class Bus;
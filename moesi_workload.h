@@ -0,0 +1,241 @@
+#ifndef MOESI_WORKLOAD_H
+#define MOESI_WORKLOAD_H
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "moesi_types.h"
+using namespace std;
+
+// xoshiro256** seeded through splitmix64. A few nanoseconds per number and a few
+// words of state, so every simulated core (and host thread) can own one.
+class FastRandom {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit FastRandom(uint64_t seed = 1) {
+        for (int i = 0; i < 4; i++) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            state[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Uniform integer in [0, n), n < 2^32 (multiply-shift, no division)
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(((next() >> 32) * n) >> 32); }
+
+    // Uniform double in [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+enum class Pattern {
+    Uniform,            // Every word equally likely.
+    Zipfian,            // Word popularity follows a Zipf distribution (skew set by zipf_theta).
+    Strided,            // Each core walks the footprint with a fixed stride from its own offset.
+    HotSpot,            // hot_probability of accesses go to the first hot_fraction of the footprint.
+    ProducerConsumer,   // Core 0 writes a ring buffer in order, the other cores read it in order.
+    Migratory,          // Read then write of the same word, words drawn from a small pool, so lines migrate.
+    ReadMostly,         // Shared footprint with read_mostly_writes of accesses being writes.
+};
+
+string patternToString(Pattern pattern) {
+    switch (pattern) {
+        case Pattern::Uniform: return "uniform";
+        case Pattern::Zipfian: return "zipfian";
+        case Pattern::Strided: return "strided";
+        case Pattern::HotSpot: return "hotspot";
+        case Pattern::ProducerConsumer: return "producer-consumer";
+        case Pattern::Migratory: return "migratory";
+        case Pattern::ReadMostly: return "read-mostly";
+        default: return "unknown";
+    }
+}
+
+bool stringToPattern(const string& name, Pattern& pattern) {
+    static const Pattern patterns[] = {
+        Pattern::Uniform, Pattern::Zipfian, Pattern::Strided, Pattern::HotSpot,
+        Pattern::ProducerConsumer, Pattern::Migratory, Pattern::ReadMostly,
+    };
+    for (Pattern candidate : patterns) {
+        if (patternToString(candidate) == name) {
+            pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct WorkloadConfig {
+    Pattern pattern;
+    int num_cores;
+    int footprint_words;        // Addresses are 4-byte aligned words in [0, 4 * footprint_words)
+    double read_weight;         // Operation mix, used by the patterns that do not fix their own
+    double write_weight;
+    double atomic_weight;
+    CpuOp atomic_op;
+    CpuOp store_op;             // Write, or Store_NT for streaming stores
+    double zipf_theta;
+    int stride_words;
+    double hot_fraction;
+    double hot_probability;
+    int buffer_words;           // ProducerConsumer ring buffer size
+    int migratory_objects;      // Migratory pool size
+    double read_mostly_writes;
+    uint64_t seed;
+
+    WorkloadConfig()
+        : pattern(Pattern::Uniform), num_cores(4), footprint_words(512),
+          read_weight(0.7), write_weight(0.25), atomic_weight(0.05), atomic_op(CpuOp::Atomic_ADD), store_op(CpuOp::Write),
+          zipf_theta(0.99), stride_words(1), hot_fraction(0.1), hot_probability(0.9),
+          buffer_words(64), migratory_objects(16), read_mostly_writes(0.02), seed(1) {}
+};
+
+// One generated access
+struct Access {
+    CpuOp op;
+    int address;
+    word_t value;
+    word_t expected;
+};
+
+// Address stream for one simulated core. Generators for different cores share
+// nothing, so each host thread can drive its own without synchronization.
+class WorkloadGenerator {
+private:
+    WorkloadConfig config;
+    int core;
+    FastRandom random;
+    unsigned long long step;
+    int pending_write;          // Migratory: address whose write follows the read, or -1
+
+    // Zipfian constants (Gray et al., "Quickly generating billion-record synthetic databases")
+    double zipf_alpha;
+    double zipf_zetan;
+    double zipf_eta;
+
+    static double zeta(int n, double theta) {
+        double sum = 0.0;
+        for (int i = 1; i <= n; i++) sum += 1.0 / pow(static_cast<double>(i), theta);
+        return sum;
+    }
+
+    int wordAddress(long word) const { return static_cast<int>(word % config.footprint_words) * 4; }
+
+    int zipfRank() {
+        double u = random.uniform();
+        double uz = u * zipf_zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + pow(0.5, config.zipf_theta)) return 1;
+        int rank = static_cast<int>(config.footprint_words * pow(zipf_eta * u - zipf_eta + 1.0, zipf_alpha));
+        return rank < config.footprint_words ? rank : config.footprint_words - 1;
+    }
+
+    Access mixedAccess(int address) {
+        double total = config.read_weight + config.write_weight + config.atomic_weight;
+        double pick = random.uniform() * total;
+        Access access = {CpuOp::Read, address, 0, 0};
+        if (pick >= config.read_weight + config.write_weight) {
+            access.op = config.atomic_op;
+            access.value = 1;
+        } else if (pick >= config.read_weight) {
+            access.op = config.store_op;
+            access.value = static_cast<word_t>(random.below(0x10000));
+        }
+        return access;
+    }
+
+public:
+    WorkloadGenerator(const WorkloadConfig& config, int core)
+        : config(config), core(core), random(config.seed * 0x100000001b3ULL + core), step(0), pending_write(-1),
+          zipf_alpha(0.0), zipf_zetan(0.0), zipf_eta(0.0) {
+        if (config.pattern == Pattern::Zipfian) {
+            double theta = config.zipf_theta;
+            zipf_zetan = zeta(config.footprint_words, theta);
+            zipf_alpha = 1.0 / (1.0 - theta);
+            zipf_eta = (1.0 - pow(2.0 / config.footprint_words, 1.0 - theta)) / (1.0 - zeta(2, theta) / zipf_zetan);
+        }
+    }
+
+    Access next() {
+        unsigned long long n = step++;
+        switch (config.pattern) {
+            case Pattern::Uniform:
+                return mixedAccess(wordAddress(random.below(config.footprint_words)));
+            case Pattern::Zipfian:
+                // Scatter ranks over the footprint so the hottest words do not share cache sets
+                return mixedAccess(wordAddress(static_cast<long>(zipfRank()) * 7919));
+            case Pattern::Strided: {
+                long start = static_cast<long>(core) * config.footprint_words / config.num_cores;
+                return mixedAccess(wordAddress(start + static_cast<long>(n) * config.stride_words));
+            }
+            case Pattern::HotSpot: {
+                int hot_words = static_cast<int>(config.footprint_words * config.hot_fraction);
+                if (hot_words < 1) hot_words = 1;
+                if (random.uniform() < config.hot_probability || hot_words >= config.footprint_words) {
+                    return mixedAccess(wordAddress(random.below(hot_words)));
+                }
+                return mixedAccess(wordAddress(hot_words + random.below(config.footprint_words - hot_words)));
+            }
+            case Pattern::ProducerConsumer: {
+                Access access = {CpuOp::Read, wordAddress(n % config.buffer_words), 0, 0};
+                if (core == 0) {
+                    access.op = config.store_op;
+                    access.value = static_cast<word_t>(n);
+                }
+                return access;
+            }
+            case Pattern::Migratory: {
+                Access access = {CpuOp::Read, 0, 0, 0};
+                if (pending_write >= 0) {
+                    access.op = config.store_op;
+                    access.address = pending_write;
+                    access.value = static_cast<word_t>(random.below(0x10000));
+                    pending_write = -1;
+                } else {
+                    access.address = wordAddress(random.below(config.migratory_objects));
+                    pending_write = access.address;
+                }
+                return access;
+            }
+            case Pattern::ReadMostly: {
+                Access access = {CpuOp::Read, wordAddress(random.below(config.footprint_words)), 0, 0};
+                if (random.uniform() < config.read_mostly_writes) {
+                    access.op = config.store_op;
+                    access.value = static_cast<word_t>(random.below(0x10000));
+                }
+                return access;
+            }
+        }
+        return mixedAccess(0);
+    }
+};
+
+// Write one access in the trace format read by TraceReader
+void writeTraceLine(ostream& out, int core, const Access& access) {
+    out << core << " " << cpuOpToString(access.op) << " 0x" << hex << access.address << dec;
+    if (access.op != CpuOp::Read && access.op != CpuOp::Load_Linked && access.op != CpuOp::PrefetchW) {
+        out << " " << access.value;
+        if (access.op == CpuOp::Atomic_CAS || access.op == CpuOp::Mem_Copy || access.op == CpuOp::Mem_Set) out << " " << access.expected;
+    }
+    out << "\n";
+}
+
+#endif // MOESI_WORKLOAD_H